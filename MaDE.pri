@@ -0,0 +1,102 @@
+#-----------------------------------------------------------------------------------------------------*/
+# Matrix Data Editor (MaDE)
+#
+# Copyright (c) 2012-2013, Alan R.T. Spencer
+#
+# This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+# General Public License as published by the Free Software Foundation; either version 3 of the License,
+# or (at your option) any later version.
+#
+# This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+# General Public License as published by the Free Software Foundation, either version 3 of the License,
+# or (at your option) any later version.
+#
+# You should have received a copy of the GNU General Public License along with this program. If not,
+# see http://www.gnu.org/licenses/.
+#-----------------------------------------------------------------------------------------------------*/
+
+# Everything but main(), shared by the application and the console NEXUS benchmark (benchmark/nexusbenchmark.pro)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/mainwindow.cpp \
+    $$PWD/settings.cpp \
+    $$PWD/database.cpp \
+    $$PWD/taxon.cpp \
+    $$PWD/character.cpp \
+    $$PWD/state.cpp \
+    $$PWD/cell.cpp \
+    $$PWD/matrix.cpp \
+    $$PWD/settingsdialog.cpp \
+    $$PWD/matrixsettingsdialog.cpp \
+    $$PWD/taxadialog.cpp \
+    $$PWD/charactersdialog.cpp \
+    $$PWD/equate.cpp \
+    $$PWD/nexusparserblock.cpp \
+    $$PWD/nexusparsercharactersblock.cpp \
+    $$PWD/nexusparserexception.cpp \
+    $$PWD/nexusparserreader.cpp \
+    $$PWD/nexusparsersetreader.cpp \
+    $$PWD/nexusparsertaxablock.cpp \
+    $$PWD/nexusparsertoken.cpp \
+    $$PWD/nexusparserassumptionsblock.cpp \
+    $$PWD/matrixgrid.cpp \
+    $$PWD/matrixtablemodel.cpp \
+    $$PWD/matrixcelldelegate.cpp \
+    $$PWD/matrixjournal.cpp \
+    $$PWD/nexusimportthread.cpp \
+    $$PWD/logsink.cpp \
+    $$PWD/nexusgenerator.cpp \
+    $$PWD/nexusbenchmark.cpp \
+    $$PWD/autosavejournal.cpp
+
+HEADERS  += $$PWD/mainwindow.h \
+    $$PWD/settings.h \
+    $$PWD/database.h \
+    $$PWD/taxon.h \
+    $$PWD/character.h \
+    $$PWD/state.h \
+    $$PWD/cell.h \
+    $$PWD/matrix.h \
+    $$PWD/settingsdialog.h \
+    $$PWD/matrixsettingsdialog.h \
+    $$PWD/taxadialog.h \
+    $$PWD/charactersdialog.h \
+    $$PWD/equate.h \
+    $$PWD/nexusparserblock.h \
+    $$PWD/nexusparsercharactersblock.h \
+    $$PWD/nexusparserexception.h \
+    $$PWD/nexusparserreader.h \
+    $$PWD/nexusparsersetreader.h \
+    $$PWD/nexusparsertaxablock.h \
+    $$PWD/nexusparsertoken.h \
+    $$PWD/nexusparser.h \
+    $$PWD/nexusparserassumptionsblock.h \
+    $$PWD/matrixgrid.h \
+    $$PWD/matrixtablemodel.h \
+    $$PWD/matrixcelldelegate.h \
+    $$PWD/matrixjournal.h \
+    $$PWD/nexusimportthread.h \
+    $$PWD/logsink.h \
+    $$PWD/nexusgenerator.h \
+    $$PWD/nexusbenchmark.h \
+    $$PWD/autosavejournal.h
+
+FORMS    += $$PWD/mainwindow.ui \
+    $$PWD/matrixTable.ui \
+    $$PWD/settingsDialog.ui \
+    $$PWD/matrixsettingsdialog.ui \
+    $$PWD/taxadialog.ui \
+    $$PWD/charactersdialog.ui
+
+# The application version
+VERSION = 0.1
+
+# Define the preprocessor macro to get the application version in our application.
+DEFINES += APP_VERSION=$$VERSION
+
+RESOURCES += \
+    $$PWD/resources.qrc
+
+OTHER_FILES += \
+    $$PWD/README.md
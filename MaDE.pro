@@ -23,67 +23,6 @@ TARGET = MaDE
 TEMPLATE = app
 
 
-SOURCES += main.cpp\
-        mainwindow.cpp \
-    settings.cpp \
-    database.cpp \
-    taxon.cpp \
-    character.cpp \
-    state.cpp \
-    cell.cpp \
-    matrix.cpp \
-    settingsdialog.cpp \
-    matrixsettingsdialog.cpp \
-    taxadialog.cpp \
-    charactersdialog.cpp \
-    equate.cpp \
-    nexusparserblock.cpp \
-    nexusparsercharactersblock.cpp \
-    nexusparserexception.cpp \
-    nexusparserreader.cpp \
-    nexusparsersetreader.cpp \
-    nexusparsertaxablock.cpp \
-    nexusparsertoken.cpp \
-    nexusparserassumptionsblock.cpp
+SOURCES += main.cpp
 
-HEADERS  += mainwindow.h \
-    settings.h \
-    database.h \
-    taxon.h \
-    character.h \
-    state.h \
-    cell.h \
-    matrix.h \
-    settingsdialog.h \
-    matrixsettingsdialog.h \
-    taxadialog.h \
-    charactersdialog.h \
-    equate.h \
-    nexusparserblock.h \
-    nexusparsercharactersblock.h \
-    nexusparserexception.h \
-    nexusparserreader.h \
-    nexusparsersetreader.h \
-    nexusparsertaxablock.h \
-    nexusparsertoken.h \
-    nexusparser.h \
-    nexusparserassumptionsblock.h
-
-FORMS    += mainwindow.ui \
-    matrixTable.ui \
-    settingsDialog.ui \
-    matrixsettingsdialog.ui \
-    taxadialog.ui \
-    charactersdialog.ui
-
-# The application version
-VERSION = 0.1
-
-# Define the preprocessor macro to get the application version in our application.
-DEFINES += APP_VERSION=$$VERSION
-
-RESOURCES += \
-    resources.qrc
-
-OTHER_FILES += \
-    README.md
+include(MaDE.pri)
@@ -0,0 +1,266 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "autosavejournal.h"
+#include "mainwindow.h"
+#include "logsink.h"
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+AutosaveJournal::AutosaveJournal(MainWindow *mw, QObject *parent) :
+    QThread(parent)
+{
+    mainwindow = mw;
+    lock = 0;
+    isStopping = false;
+    fileName = QDir(recoveryPath()).filePath(QUuid::createUuid().toString().mid(1, 36) + ".journal");
+}
+
+AutosaveJournal::~AutosaveJournal()
+{
+    close();
+    delete lock;
+}
+
+// Start a new journal for the matrix described by header
+bool AutosaveJournal::create(Header header)
+{
+    if (!openFile(fileName, QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << (quint32)formatVersion << header.baseFile << header.isSnapshot << header.baseModified << header.title << header.created;
+    pending = frame(HeaderRecord, payload);
+
+    start(QThread::LowPriority);
+    return true;
+}
+
+// Carry on appending to a journal left behind by another session, once it has been replayed
+bool AutosaveJournal::resume(QString name)
+{
+    fileName = name;
+    if (!openFile(fileName, QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    start(QThread::LowPriority);
+    return true;
+}
+
+bool AutosaveJournal::openFile(QString name, QIODevice::OpenMode mode)
+{
+    lock = new QLockFile(name + ".lock");
+    if (!lock->tryLock(0)) {
+        return false;
+    }
+    file.setFileName(name);
+    return file.open(mode);
+}
+
+// Queue a record, it is written by the journal thread with whatever else arrives within commitInterval
+void AutosaveJournal::append(RecordType type, QByteArray payload)
+{
+    QByteArray record = frame(type, payload);
+
+    QMutexLocker locker(&mutex);
+    bool wasEmpty = pending.isEmpty();
+    pending.append(record);
+    if (wasEmpty || pending.size() >= commitBytes) {
+        hasPending.wakeOne();
+    }
+}
+
+// Write anything pending and stop the thread, the journal stays on disk
+void AutosaveJournal::close()
+{
+    mutex.lock();
+    isStopping = true;
+    hasPending.wakeOne();
+    mutex.unlock();
+    wait();
+
+    file.close();
+    if (lock) {
+        lock->unlock();
+    }
+}
+
+// Close and delete the journal, its snapshot and lock, the matrix has been saved or closed
+void AutosaveJournal::discard()
+{
+    close();
+    remove(fileName);
+}
+
+void AutosaveJournal::run()
+{
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        while (pending.isEmpty() && !isStopping) {
+            hasPending.wait(&mutex);
+        }
+        if (pending.isEmpty()) {
+            break;
+        }
+
+        // Give the records that follow an edit a chance to join its batch
+        if (!isStopping && pending.size() < commitBytes) {
+            hasPending.wait(&mutex, commitInterval);
+        }
+
+        QByteArray batch;
+        batch.swap(pending);
+        locker.unlock();
+
+        if (file.write(batch) != batch.size()) {
+            mainwindow->logSink->append(LogSink::Error, "Autosave", QString("could not write to \"%1\": %2.").arg(fileName).arg(file.errorString()));
+        }
+        sync();
+
+        locker.relock();
+    }
+}
+
+// Get the batch onto the disk before the next one is started
+void AutosaveJournal::sync()
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    fsync(file.handle());
+#endif
+}
+
+QByteArray AutosaveJournal::frame(RecordType type, QByteArray payload)
+{
+    QByteArray data;
+    data.reserve(payload.size() + 1);
+    data.append((char)type);
+    data.append(payload);
+
+    QByteArray record;
+    record.resize(4);
+    qToLittleEndian<quint32>(data.size(), (uchar *)record.data());
+    record.append(data);
+
+    quint16 crc = qChecksum(data.constData(), data.size());
+    record.append((char)(crc & 0xFF));
+    record.append((char)(crc >> 8));
+    return record;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Return Functions
+ *-----------------------------------------------------------------------------------*/
+
+QString AutosaveJournal::getFileName()
+{
+    return fileName;
+}
+
+// Base file of an untitled matrix
+QString AutosaveJournal::getSnapshotFileName()
+{
+    return fileName.left(fileName.size() - QString(".journal").size()) + ".made";
+}
+
+/*------------------------------------------------------------------------------------/
+ * Recovery Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Folder holding the journals, next to settings.ini
+QString AutosaveJournal::recoveryPath()
+{
+    QDir().mkpath("recovery");
+    return QDir("recovery").absolutePath();
+}
+
+// Journals whose lock is not held, i.e. left behind by a session that did not close properly
+QStringList AutosaveJournal::findOrphans()
+{
+    QStringList orphans;
+    QDir directory(recoveryPath());
+    QStringList names = directory.entryList(QStringList() << "*.journal", QDir::Files, QDir::Time | QDir::Reversed);
+    for (int i = 0; i < names.count(); i++) {
+        QString name = directory.filePath(names.at(i));
+        QLockFile lockFile(name + ".lock");
+        if (lockFile.tryLock(0)) {
+            lockFile.unlock();
+            orphans.append(name);
+        }
+    }
+    return orphans;
+}
+
+// Read the header and every complete record of a journal, returns false if it does not have a header
+bool AutosaveJournal::read(QString name, Header &header, QList<Record> &records)
+{
+    QFile journal(name);
+    if (!journal.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray data = journal.readAll();
+    journal.close();
+
+    records.clear();
+    int position = 0;
+    while (position + 4 <= data.size()) {
+        quint32 size = qFromLittleEndian<quint32>((const uchar *)data.constData() + position);
+        if (size < 1 || (qint64)position + 4 + size + 2 > data.size()) {
+            break;
+        }
+        const char *record = data.constData() + position + 4;
+        quint16 crc = (quint8)record[size] | ((quint8)record[size + 1] << 8);
+        if (crc != qChecksum(record, size)) {
+            break;
+        }
+
+        Record item;
+        item.type = (RecordType)(quint8)record[0];
+        item.payload = QByteArray(record + 1, size - 1);
+        records.append(item);
+        position += 4 + size + 2;
+    }
+
+    if (records.isEmpty() || records.first().type != HeaderRecord) {
+        return false;
+    }
+
+    QDataStream in(records.first().payload);
+    quint32 version;
+    in >> version >> header.baseFile >> header.isSnapshot >> header.baseModified >> header.title >> header.created;
+    records.removeFirst();
+    return (in.status() == QDataStream::Ok && version == formatVersion);
+}
+
+// Delete a journal and what goes with it
+void AutosaveJournal::remove(QString name)
+{
+    QString baseName = name.left(name.size() - QString(".journal").size());
+    QFile::remove(baseName + ".made");
+    QFile::remove(baseName + ".made-wal");
+    QFile::remove(baseName + ".made-shm");
+    QFile::remove(name);
+    QFile::remove(name + ".lock");
+}
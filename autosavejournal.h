@@ -0,0 +1,102 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef AUTOSAVEJOURNAL_H
+#define AUTOSAVEJOURNAL_H
+
+#include <QtWidgets>
+
+class MainWindow;
+
+// Crash recovery journal of one open matrix. Every change to the matrix is appended as a record, the records
+// being written by the journal's own thread a batch at a time with one fsync per batch (group commit), so append()
+// never waits on the disk. The records apply to a base file: the matrix's .made file, or for an untitled matrix a
+// snapshot saved next to the journal when it was started. Journals live in the recovery folder and are removed when
+// the matrix is saved or closed; each holds a lock file while open, so a journal whose lock can be taken was left
+// behind by a session that did not close properly.
+//
+// Each record is a little endian quint32 length, a type byte and its payload, then a quint16 CRC of the type and
+// payload. Reading stops at the first short or damaged record, i.e. a batch that was being written at the crash.
+class AutosaveJournal : public QThread
+{
+    Q_OBJECT
+
+public:
+    AutosaveJournal(MainWindow *mw, QObject *parent = 0);
+    ~AutosaveJournal();
+
+    enum RecordType {
+        HeaderRecord = 0,
+        SymbolsRecord,
+        ApplyRecord,
+        UndoRecord,
+        DetailsRecord,
+        CharactersRecord
+    };
+
+    struct Header {
+        QString baseFile;
+        bool isSnapshot;
+        QDateTime baseModified;
+        QString title;
+        QDateTime created;
+    };
+
+    struct Record {
+        RecordType type;
+        QByteArray payload;
+    };
+
+    bool create(Header header);
+    bool resume(QString name);
+    void append(RecordType type, QByteArray payload);
+    void close();
+    void discard();
+
+    QString getFileName();
+    QString getSnapshotFileName();
+
+    static QString recoveryPath();
+    static QStringList findOrphans();
+    static bool read(QString name, Header &header, QList<Record> &records);
+    static void remove(QString name);
+
+protected:
+    void run();
+
+private:
+    MainWindow *mainwindow;
+    QString fileName;
+    QFile file;
+    QLockFile *lock;
+
+    // Records waiting for the next commit, shared with the journal thread
+    QMutex mutex;
+    QWaitCondition hasPending;
+    QByteArray pending;
+    bool isStopping;
+
+    enum { formatVersion = 3 };  // of the header and records, a journal in another format is not replayed
+    enum { commitInterval = 250 };  // ms a record may wait for others to be written with it
+    enum { commitBytes = 4 * 1024 * 1024 };  // pending bytes that are written without waiting
+
+    bool openFile(QString name, QIODevice::OpenMode mode);
+    void sync();
+    static QByteArray frame(RecordType type, QByteArray payload);
+};
+
+#endif // AUTOSAVEJOURNAL_H
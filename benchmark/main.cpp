@@ -0,0 +1,92 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "settings.h"
+#include "nexusbenchmark.h"
+
+// Runs the NEXUS reader benchmark without a window. Each case is printed on one line in the format of the
+// application log. Given the output of an earlier run as a baseline, a case whose tokenize or import rate has
+// dropped by more than the tolerance is reported as a regression. The exit code is 1 after a regression or a
+// failed import.
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("nexusbenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the MaDE NEXUS reader on generated files.");
+    parser.addHelpOption();
+    QCommandLineOption baselineOption("baseline", "Compare with the output of an earlier run.", "file");
+    QCommandLineOption toleranceOption("tolerance", "Slow down allowed before a case fails, in percent (10).", "percent", "10");
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+    parser.process(a);
+
+    QTextStream out(stdout);
+
+    // Only the default settings are used, so a run does not depend on the settings.ini it happens to find
+    Settings settings;
+    NexusBenchmark benchmark(0, &settings);
+    QList<NexusBenchmark::Result> results = benchmark.run(0);
+
+    bool isFailed = (results.count() != benchmark.cases().count());
+    QHash<QString, QPair<double, double> > rates;
+    for (int i = 0; i < results.count(); i++) {
+        QString line = benchmark.formatResult(results[i]);
+        out << line << "\n";
+
+        QString name;
+        double tokenizeRate, importRate;
+        if (NexusBenchmark::parseResult(line, name, tokenizeRate, importRate)) {
+            rates.insert(name, qMakePair(tokenizeRate, importRate));
+        }
+        isFailed = isFailed || !results[i].isImported;
+    }
+
+    if (parser.isSet(baselineOption)) {
+        QFile file(parser.value(baselineOption));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            out << QString("cannot read baseline \"%1\".\n").arg(file.fileName());
+            return 1;
+        }
+
+        double tolerance = parser.value(toleranceOption).toDouble() / 100.0;
+        QTextStream in(&file);
+        while (!in.atEnd()) {
+            QString name;
+            double tokenizeRate, importRate;
+            if (!NexusBenchmark::parseResult(in.readLine(), name, tokenizeRate, importRate) || !rates.contains(name)) {
+                continue;
+            }
+            QPair<double, double> rate = rates.value(name);
+            if (rate.first < tokenizeRate * (1.0 - tolerance)) {
+                out << QString("REGRESSION %1: tokenize %2 MB/s, was %3 MB/s.\n").arg(name).arg(rate.first).arg(tokenizeRate);
+                isFailed = true;
+            }
+            if (rate.second < importRate * (1.0 - tolerance)) {
+                out << QString("REGRESSION %1: import %2 MB/s, was %3 MB/s.\n").arg(name).arg(rate.second).arg(importRate);
+                isFailed = true;
+            }
+        }
+    }
+
+    out.flush();
+    return (isFailed ? 1 : 0);
+}
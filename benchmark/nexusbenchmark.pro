@@ -0,0 +1,33 @@
+#-----------------------------------------------------------------------------------------------------*/
+# Matrix Data Editor (MaDE)
+#
+# Copyright (c) 2012-2013, Alan R.T. Spencer
+#
+# This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+# General Public License as published by the Free Software Foundation; either version 3 of the License,
+# or (at your option) any later version.
+#
+# This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+# General Public License as published by the Free Software Foundation, either version 3 of the License,
+# or (at your option) any later version.
+#
+# You should have received a copy of the GNU General Public License along with this program. If not,
+# see http://www.gnu.org/licenses/.
+#-----------------------------------------------------------------------------------------------------*/
+
+# Console NEXUS reader benchmark, built from the application's sources so that it can run headless (e.g. in CI).
+# Run it with no arguments to print the figures, or with --baseline <output of an earlier run> to have it exit
+# with code 1 when a case has slowed down by more than --tolerance percent.
+
+QT       += core gui sql
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = nexusbenchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
+
+include(../MaDE.pri)
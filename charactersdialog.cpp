@@ -256,19 +256,9 @@ void CharactersDialog::saveData(int row)
             name = "Undefined";
         }
 
-        matrix->characterList[row].setLabel(name);
+        matrix->characterEdit(row, name, notesTextEdit->toHtml(), isEnabledCheckBox->isChecked(), !unorderedRadioButton->isChecked());
         characterListTableWidget->item(row, 0)->setText(name);
         mw->updateCharacterDock();
-
-        matrix->characterList[row].setNotes(notesTextEdit->toHtml());
-        matrix->characterList[row].setIsEnabled(isEnabledCheckBox->isChecked());
-
-        if (unorderedRadioButton->isChecked()) {
-            matrix->characterList[row].setIsOrdered(false);
-        } else {
-            matrix->characterList[row].setIsOrdered(true);
-        }
-
         mw->updateDataDock();
     } else {
         doNotSave = false;
@@ -380,10 +370,8 @@ void CharactersDialog::orderRadioActions(QAbstractButton *button)
 {
     if (button->text() == tr("Unordered")) {
         mw->logAppend("Characters Dialog","'Unordered' pressed.");
-        matrix->characterList[selectedRow].setIsOrdered(false);
     } else if (button->text() == tr("Ordered")) {
         mw->logAppend("Characters Dialog","'Ordered' pressed.");
-        matrix->characterList[selectedRow].setIsOrdered(true);
     }
 }
 
@@ -408,7 +396,6 @@ void CharactersDialog::actionUpArrow()
         moveRow(true);
         matrix->moveColumn(currentSelectedRow, true);
         mw->moveCharacterDockTableRow(currentSelectedRow, true);
-        matrix->characterList.move(currentSelectedRow,currentSelectedRow-1);
         updateButtons(currentSelectedRow-1);
     }
 }
@@ -420,7 +407,6 @@ void CharactersDialog::actionDownArrow()
         moveRow(false);
         matrix->moveColumn(currentSelectedRow, false);
         mw->moveCharacterDockTableRow(currentSelectedRow, false);
-        matrix->characterList.move(currentSelectedRow,currentSelectedRow+1);
         updateButtons(currentSelectedRow+1);
     }
 }
@@ -530,7 +516,6 @@ void CharactersDialog::updateCharactersTableColor(int row, bool isEnabled)
 
 void CharactersDialog::isEnabledChanged(bool isEnabled)
 {
-    matrix->characterList[selectedRow].setIsEnabled(isEnabled);
     updateCharactersTableColor(selectedRow, isEnabled);
     mw->updateCharacterDockTableColor(selectedRow, isEnabled);
 }
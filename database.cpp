@@ -15,41 +15,70 @@
  * see http://www.gnu.org/licenses/.
  *-----------------------------------------------------------------------------------------------------*/
 
+#include <climits>
+
 #include "database.h"
+#include "matrix.h"
 
 Database::Database()
 {
-    db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName(settings->getSetting("defaultDatabaseName").toString());
-    if (db.open()) {
-        qDebug() << "SQLite: Database found and opened.";
-        /* Check if there is a SQLite DB available. If yes then connect,
-         * if not then ask if user wants to load a db file or create a new
-         * db
-         */
-        QSqlQuery query(db);
-        if ( !query.exec("SELECT * FROM settings;") ) {
-            // No settings table found...
-            this->createSchema();
-        }
-    } else {
-        qDebug() << "SQLite: Error - No Database File found.";
+    // Every Database has its own connection, so more than one file can be open at a time
+    static int connectionCount = 0;
+    connectionName = QString("MaDE%1").arg(++connectionCount);
+    storageMode = RowStorage;
+}
+
+Database::~Database()
+{
+    close();
+}
+
+// Open or create the SQLite file
+bool Database::open(QString fileName)
+{
+    db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(fileName);
+    if (!db.open()) {
+        return fail(db.lastError());
+    }
+
+    // Write ahead logging, readers are never blocked by a save and a save only syncs the log once per commit
+    return (execute("PRAGMA journal_mode=WAL;")
+            && execute("PRAGMA synchronous=NORMAL;")
+            && execute("PRAGMA temp_store=MEMORY;"));
+}
+
+void Database::close()
+{
+    if (db.isValid()) {
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connectionName);
     }
 }
 
+QString Database::lastError()
+{
+    return errorText;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Schema
+ *-----------------------------------------------------------------------------------*/
+
 // Create Database Tables
-void Database::createSchema()
+bool Database::createSchema()
 {
-    QSqlQuery query(db);
-    // No database tables found... assume we need to create.
-    query.exec(
+    if (!execute(
         "CREATE TABLE settings("
         "ID INTEGER PRIMARY KEY AUTOINCREMENT,"
         "name TEXT NOT NULL,"
         "value TEXT NOT NULL"
         ");"
-    );
-    query.exec(
+    )) {
+        return false;
+    }
+    if (!execute(
         "CREATE TABLE matrices("
         "ID INTEGER PRIMARY KEY AUTOINCREMENT,"
         "prefix TEXT NOT NULL,"
@@ -57,18 +86,112 @@ void Database::createSchema()
         "description TEXT NOT NULL,"
         "creationDate DATETIME NOT NULL,"
         "lastEditDate DATETIME,"
-        "notes TEXT"
+        "notes TEXT,"
+        "type INTEGER NOT NULL,"
+        "missing TEXT NOT NULL,"
+        "gap TEXT NOT NULL,"
+        "storage INTEGER NOT NULL,"
+        "symbols TEXT NOT NULL"
         ");"
-    );
-    qDebug() << "SQLite: Created a new database schema.";
+    )) {
+        return false;
+    }
 
     // Set default settings
     this->setSetting("appName", "Matrix Data Editor (MaDE)");
     this->setSetting("appVersion", QString::number(APP_VERSION, 'f', 1) );
     QDateTime currentDate = QDateTime::currentDateTime();
     this->setSetting("creationDate", currentDate.toString("yyyy-MM-dd hh:mm:ss") );
+    return true;
+}
+
+// Create the table set of one matrix. Taxa and characters keep their IDs and their order in the matrix, cells
+// are keyed by those IDs, either one row per cell in _data or one row per taxon in _rows with the notes in _notes.
+bool Database::newMatrix(QString tablePrefix)
+{
+    if (!execute(
+        "CREATE TABLE "+tablePrefix+"_taxa("
+        "TID INTEGER PRIMARY KEY,"
+        "position INTEGER NOT NULL,"
+        "name TEXT NOT NULL,"
+        "notes TEXT,"
+        "enabled INTEGER NOT NULL"
+        ");"
+    ) || !execute(
+        "CREATE TABLE "+tablePrefix+"_characters("
+        "CID INTEGER PRIMARY KEY,"
+        "position INTEGER NOT NULL,"
+        "slot INTEGER NOT NULL,"
+        "name TEXT NOT NULL,"
+        "notes TEXT,"
+        "enabled INTEGER NOT NULL,"
+        "eliminated INTEGER NOT NULL,"
+        "ordered INTEGER NOT NULL"
+        ");"
+    ) || !execute(
+        "CREATE TABLE "+tablePrefix+"_states("
+        "SID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "CID INTEGER NOT NULL,"
+        "state INTEGER NOT NULL,"
+        "symbol TEXT NOT NULL,"
+        "name TEXT NOT NULL,"
+        "notes TEXT"
+        ");"
+    ) || !execute(
+        "CREATE TABLE "+tablePrefix+"_equates("
+        "EID INTEGER PRIMARY KEY,"
+        "symbol TEXT NOT NULL,"
+        "equivalent TEXT NOT NULL,"
+        "enabled INTEGER NOT NULL"
+        ");"
+    )) {
+        return false;
+    }
+
+    if (storageMode == CellStorage) {
+        return execute(
+            "CREATE TABLE "+tablePrefix+"_data("
+            "ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "TID INTEGER NOT NULL,"
+            "CID INTEGER NOT NULL,"
+            "state TEXT,"
+            "notes TEXT"
+            ");"
+        );
+    }
+
+    // TID is the rowid of _rows and leads the key of _notes, so both are indexed on the taxon and a taxon or a
+    // range of taxa is read without touching the rest of the matrix
+    return (execute(
+        "CREATE TABLE "+tablePrefix+"_rows("
+        "TID INTEGER PRIMARY KEY,"
+        "data BLOB NOT NULL"
+        ");"
+    ) && execute(
+        "CREATE TABLE "+tablePrefix+"_notes("
+        "TID INTEGER NOT NULL,"
+        "CID INTEGER NOT NULL,"
+        "notes TEXT NOT NULL,"
+        "PRIMARY KEY(TID,CID)"
+        ");"
+    ));
 }
 
+void Database::setStorageMode(StorageMode mode)
+{
+    storageMode = mode;
+}
+
+// The storage of the last matrix saved or loaded
+Database::StorageMode Database::getStorageMode()
+{
+    return storageMode;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Settings
+ *-----------------------------------------------------------------------------------*/
+
 // Create Settings
 void Database::setSetting(QString name, QString value) {
     QSqlQuery query(db);
@@ -95,48 +218,723 @@ QString Database::getSetting(QString name) {
     return value;
 }
 
-// Create New Matrix
-void Database::newMatrix(){
+/*------------------------------------------------------------------------------------/
+ * Save
+ *-----------------------------------------------------------------------------------*/
+
+// Write the whole matrix to a newly created file in one transaction
+bool Database::saveMatrix(Matrix *matrix)
+{
+    QString prefix = "matrix";
+
+    // Row BLOBs hold their cells in the current character order
+    QVector<int> rowOrder(matrix->characterList.count());
+    for (int c = 0; c < rowOrder.count(); c++) {
+        rowOrder[c] = matrix->characterList[c].getID();
+    }
+
+    if (!db.transaction()) {
+        return fail(db.lastError());
+    }
+    if (!createSchema() || !newMatrix(prefix)) {
+        db.rollback();
+        return false;
+    }
+
     QSqlQuery query(db);
-    QString tablePrefix;
-    int defaultNumTaxa;
-    int defaultNumCharacter;
+    QString now = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    query.prepare("INSERT INTO matrices(prefix,name,description,creationDate,lastEditDate,notes,type,missing,gap,storage,symbols) "
+                  "VALUES (?,?,?,?,?,?,?,?,?,?,?);");
+    query.addBindValue(prefix);
+    query.addBindValue(matrix->matrixName);
+    query.addBindValue(matrix->matrixDescription);
+    query.addBindValue(now);
+    query.addBindValue(now);
+    query.addBindValue(QString());
+    query.addBindValue(matrix->matrixType);
+    query.addBindValue(matrix->missingCharacter);
+    query.addBindValue(matrix->gapCharacter);
+    query.addBindValue((int)storageMode);
+    query.addBindValue(matrix->matrixGrid.getSymbols());
+    if (!execute(query)) {
+        db.rollback();
+        return false;
+    }
 
-    // Add entry into matrices table
+    bool isSaved = (saveTaxa(matrix, prefix, true)
+                    && saveCharacters(matrix, prefix, rowOrder, true)
+                    && saveEquates(matrix, prefix));
+    if (isSaved) {
+        if (storageMode == CellStorage) {
+            isSaved = saveCells(matrix, prefix);
+        } else {
+            isSaved = (saveRows(matrix, prefix, rowOrder, true) && saveNotes(matrix, prefix, true));
+        }
+    }
+    if (!isSaved) {
+        db.rollback();
+        return false;
+    }
 
+    if (!db.commit()) {
+        fail(db.lastError());
+        db.rollback();
+        return false;
+    }
+    matrix->savedCharacterOrder = rowOrder;
+    return true;
+}
 
-    // Create matrix table set
-    query.exec(
-        "CREATE TABLE "+tablePrefix+"_data("
-        "ID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "TID INTEGER NOT NULL,"
-        "CID INTEGER NOT NULL,"
-        "state TEXT,"
-        "notes TEXT,"
-        ");"
-    );
-    query.exec(
-        "CREATE TABLE "+tablePrefix+"_taxa("
-        "TID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "name TEXT NOT NULL,"
-        "notes TEXT"
-        ");"
-    );
-    query.exec(
-        "CREATE TABLE "+tablePrefix+"_characters("
-        "CID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "name TEXT NOT NULL,"
-        "notes TEXT"
-        ");"
-    );
-    query.exec(
-        "CREATE TABLE "+tablePrefix+"_states("
-        "SID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "CID INTEGER NOT NULL,"
-        "state INTEGER NOT NULL,"
-        "name TEXT NOT NULL,"
-        "notes TEXT"
-        ");"
-    );
+// Write only what has changed since the matrix was last saved to or opened from this file, see
+// Matrix::markRowDirty(). Small edits cost the same however big the matrix is. Only for RowStorage files.
+bool Database::saveChanges(Matrix *matrix)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT prefix,storage FROM matrices ORDER BY ID LIMIT 1;");
+    if (!execute(query)) {
+        return false;
+    }
+    if (!query.next() || query.value(1).toInt() != RowStorage) {
+        errorText = "The file does not hold a matrix with one row per taxon.";
+        return false;
+    }
+    QString prefix = query.value(0).toString();
+    query.finish();
+
+    // Adding or removing characters changes every row, the rows are then written again in the new order
+    QVector<int> rowOrder = matrix->savedCharacterOrder;
+    if (matrix->hasAllRowsDirty) {
+        rowOrder.resize(matrix->characterList.count());
+        for (int c = 0; c < rowOrder.count(); c++) {
+            rowOrder[c] = matrix->characterList[c].getID();
+        }
+    }
+
+    if (!db.transaction()) {
+        return fail(db.lastError());
+    }
+
+    // The matrix details and equates are a handful of values, they are always written
+    query.prepare("UPDATE matrices SET name=?,description=?,lastEditDate=?,type=?,missing=?,gap=?,symbols=? WHERE prefix=?;");
+    query.addBindValue(matrix->matrixName);
+    query.addBindValue(matrix->matrixDescription);
+    query.addBindValue(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss"));
+    query.addBindValue(matrix->matrixType);
+    query.addBindValue(matrix->missingCharacter);
+    query.addBindValue(matrix->gapCharacter);
+    query.addBindValue(matrix->matrixGrid.getSymbols());
+    query.addBindValue(prefix);
+    bool isSaved = (execute(query)
+                    && execute("DELETE FROM "+prefix+"_equates;")
+                    && saveEquates(matrix, prefix));
+
+    if (isSaved && matrix->isTaxonListDirty) {
+        isSaved = (execute("DELETE FROM "+prefix+"_taxa;") && saveTaxa(matrix, prefix, true));
+    } else if (isSaved) {
+        isSaved = saveTaxa(matrix, prefix, false);
+    }
+
+    if (isSaved && (matrix->isCharacterListDirty || matrix->hasAllRowsDirty)) {
+        isSaved = (execute("DELETE FROM "+prefix+"_characters;")
+                   && execute("DELETE FROM "+prefix+"_states;")
+                   && saveCharacters(matrix, prefix, rowOrder, true));
+    } else if (isSaved) {
+        isSaved = saveCharacters(matrix, prefix, rowOrder, false);
+    }
+
+    if (isSaved && matrix->hasAllRowsDirty) {
+        isSaved = (execute("DELETE FROM "+prefix+"_rows;")
+                   && saveRows(matrix, prefix, rowOrder, true));
+    } else if (isSaved) {
+        isSaved = saveRows(matrix, prefix, rowOrder, false);
+    }
+
+    if (isSaved) {
+        isSaved = saveNotes(matrix, prefix, false);
+    }
+
+    if (!isSaved) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        fail(db.lastError());
+        db.rollback();
+        return false;
+    }
+    matrix->savedCharacterOrder = rowOrder;
+    return true;
+}
+
+// All taxa, or only the dirty ones in place
+bool Database::saveTaxa(Matrix *matrix, QString prefix, bool isAll)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO "+prefix+"_taxa(TID,position,name,notes,enabled) VALUES (?,?,?,?,?);");
+
+    QList<int> positions;
+    if (isAll) {
+        for (int i = 0; i < matrix->taxonList.count(); i++) {
+            positions.append(i);
+        }
+    } else {
+        foreach (int taxonID, matrix->dirtyTaxa) {
+            int position = matrix->taxonPosition(taxonID);
+            if (position != -1) {
+                positions.append(position);
+            }
+        }
+    }
+
+    for (int i = 0; i < positions.count(); i++) {
+        Taxon &taxon = matrix->taxonList[positions.at(i)];
+        query.bindValue(0, taxon.getID());
+        query.bindValue(1, positions.at(i));
+        query.bindValue(2, taxon.getLabel());
+        query.bindValue(3, taxon.getNotes());
+        query.bindValue(4, taxon.getIsEnabled() ? 1 : 0);
+        if (!execute(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// All characters and their states, or only the dirty ones in place. slot is where the character's cells sit in
+// the row BLOBs, which stays put when characters are only moved.
+bool Database::saveCharacters(Matrix *matrix, QString prefix, QVector<int> rowOrder, bool isAll)
+{
+    QHash<int,int> slots;
+    for (int i = 0; i < rowOrder.count(); i++) {
+        slots.insert(rowOrder.at(i), i);
+    }
+
+    QList<int> positions;
+    if (isAll) {
+        for (int i = 0; i < matrix->characterList.count(); i++) {
+            positions.append(i);
+        }
+    } else {
+        foreach (int characterID, matrix->dirtyCharacters) {
+            int position = matrix->characterPosition(characterID);
+            if (position != -1) {
+                positions.append(position);
+            }
+        }
+    }
 
+    QSqlQuery query(db);
+    QSqlQuery stateQuery(db);
+    QSqlQuery removeStatesQuery(db);
+    query.prepare("INSERT OR REPLACE INTO "+prefix+"_characters(CID,position,slot,name,notes,enabled,eliminated,ordered) VALUES (?,?,?,?,?,?,?,?);");
+    stateQuery.prepare("INSERT INTO "+prefix+"_states(CID,state,symbol,name,notes) VALUES (?,?,?,?,?);");
+    removeStatesQuery.prepare("DELETE FROM "+prefix+"_states WHERE CID=?;");
+    for (int i = 0; i < positions.count(); i++) {
+        Character &character = matrix->characterList[positions.at(i)];
+        query.bindValue(0, character.getID());
+        query.bindValue(1, positions.at(i));
+        query.bindValue(2, slots.value(character.getID(), -1));
+        query.bindValue(3, character.getLabel());
+        query.bindValue(4, character.getNotes());
+        query.bindValue(5, character.getIsEnabled() ? 1 : 0);
+        query.bindValue(6, character.getIsEliminated() ? 1 : 0);
+        query.bindValue(7, character.getIsOrdered() ? 1 : 0);
+        if (!execute(query)) {
+            return false;
+        }
+
+        if (!isAll) {
+            removeStatesQuery.bindValue(0, character.getID());
+            if (!execute(removeStatesQuery)) {
+                return false;
+            }
+        }
+        for (int s = 0; s < character.countStates(); s++) {
+            State state = character.getState(s);
+            stateQuery.bindValue(0, character.getID());
+            stateQuery.bindValue(1, s);
+            stateQuery.bindValue(2, state.getSymbol());
+            stateQuery.bindValue(3, state.getLabel());
+            stateQuery.bindValue(4, state.getNotes());
+            if (!execute(stateQuery)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Database::saveEquates(Matrix *matrix, QString prefix)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO "+prefix+"_equates(EID,symbol,equivalent,enabled) VALUES (?,?,?,?);");
+    for (int i = 0; i < matrix->equateList.count(); i++) {
+        Equate &equate = matrix->equateList[i];
+        query.bindValue(0, equate.getID());
+        query.bindValue(1, equate.getSymbol());
+        query.bindValue(2, equate.getEquivalent());
+        query.bindValue(3, equate.getIsEnabled() ? 1 : 0);
+        if (!execute(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// One _data row per cell
+bool Database::saveCells(Matrix *matrix, QString prefix)
+{
+    QSqlQuery query(db);
+
+    // Row by row in matrix order and cellsPerInsert to a statement. The state text of each distinct
+    // state set is only worked out once.
+    query.prepare(insertStatement(prefix+"_data", "TID,CID,state,notes", 4, cellsPerInsert));
+    QHash<QPair<quint64,int>, QString> stateText;
+    int pending = 0;
+    for (int t = 0; t < matrix->taxonList.count(); t++) {
+        int taxonID = matrix->taxonList[t].getID();
+        for (int c = 0; c < matrix->characterList.count(); c++) {
+            int characterID = matrix->characterList[c].getID();
+            if (!matrix->matrixGrid.hasCell(taxonID, characterID)) {
+                continue;
+            }
+
+            QPair<quint64,int> cell = qMakePair(matrix->matrixGrid.getStateSet(taxonID, characterID),
+                                                matrix->matrixGrid.getFlags(taxonID, characterID));
+            QHash<QPair<quint64,int>, QString>::const_iterator text = stateText.constFind(cell);
+            if (text == stateText.constEnd()) {
+                text = stateText.insert(cell, matrix->matrixGrid.decodeState(cell.first, cell.second));
+            }
+
+            int value = pending * 4;
+            query.bindValue(value, taxonID);
+            query.bindValue(value + 1, characterID);
+            query.bindValue(value + 2, text.value());
+            query.bindValue(value + 3, matrix->cellNotesTable.value(qMakePair(taxonID, characterID)));
+            pending++;
+
+            if (pending == cellsPerInsert) {
+                if (!execute(query)) {
+                    return false;
+                }
+                pending = 0;
+            }
+        }
+    }
+
+    // Whatever is left over goes in one shorter statement
+    if (pending > 0) {
+        QSqlQuery tailQuery(db);
+        tailQuery.prepare(insertStatement(prefix+"_data", "TID,CID,state,notes", 4, pending));
+        for (int i = 0; i < pending * 4; i++) {
+            tailQuery.bindValue(i, query.boundValue(i));
+        }
+        if (!execute(tailQuery)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// One _rows row per taxon, its cells in rowOrder packed by encodeRow(). Unless isAll only the dirty rows are
+// written, and the rows of taxa that have gone are deleted.
+bool Database::saveRows(Matrix *matrix, QString prefix, QVector<int> rowOrder, bool isAll)
+{
+    QList<int> taxonIDs;
+    if (isAll) {
+        for (int t = 0; t < matrix->taxonList.count(); t++) {
+            taxonIDs.append(matrix->taxonList[t].getID());
+        }
+    } else {
+        taxonIDs = matrix->dirtyTaxonRows.toList();
+    }
+
+    QSqlQuery query(db);
+    QSqlQuery removeQuery(db);
+    query.prepare("INSERT OR REPLACE INTO "+prefix+"_rows(TID,data) VALUES (?,?);");
+    removeQuery.prepare("DELETE FROM "+prefix+"_rows WHERE TID=?;");
+    for (int t = 0; t < taxonIDs.count(); t++) {
+        int taxonID = taxonIDs.at(t);
+        if (rowOrder.isEmpty() || !matrix->matrixGrid.hasCell(taxonID, rowOrder.at(0))) {
+            if (!isAll) {
+                removeQuery.bindValue(0, taxonID);
+                if (!execute(removeQuery)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        query.bindValue(0, taxonID);
+        query.bindValue(1, encodeRow(matrix->matrixGrid, taxonID, rowOrder));
+        if (!execute(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The sparse cell notes of row storage, all of them or only the dirty ones. Notes that have been cleared are
+// deleted.
+bool Database::saveNotes(Matrix *matrix, QString prefix, bool isAll)
+{
+    QSqlQuery query(db);
+    QSqlQuery removeQuery(db);
+    query.prepare("INSERT OR REPLACE INTO "+prefix+"_notes(TID,CID,notes) VALUES (?,?,?);");
+    removeQuery.prepare("DELETE FROM "+prefix+"_notes WHERE TID=? AND CID=?;");
+
+    QList<QPair<int,int> > cells = (isAll ? matrix->cellNotesTable.keys() : matrix->dirtyNotes.toList());
+    for (int i = 0; i < cells.count(); i++) {
+        QHash<QPair<int,int>, QString>::const_iterator notes = matrix->cellNotesTable.constFind(cells.at(i));
+        if (notes == matrix->cellNotesTable.constEnd()) {
+            removeQuery.bindValue(0, cells.at(i).first);
+            removeQuery.bindValue(1, cells.at(i).second);
+            if (!execute(removeQuery)) {
+                return false;
+            }
+            continue;
+        }
+        query.bindValue(0, cells.at(i).first);
+        query.bindValue(1, cells.at(i).second);
+        query.bindValue(2, notes.value());
+        if (!execute(query)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A taxon's cells as one byte per cell, holding the flags and whether a state set follows, then the state set
+// as a 7 bits per byte varint. Most rows repeat a handful of cells, so the whole row is then zlib compressed.
+QByteArray Database::encodeRow(MatrixGrid &grid, int taxonID, const QVector<int> &characterIDs)
+{
+    QByteArray row;
+    row.reserve(characterIDs.count() * 2);
+    for (int c = 0; c < characterIDs.count(); c++) {
+        quint64 stateSet = grid.getStateSet(taxonID, characterIDs.at(c));
+        int flags = grid.getFlags(taxonID, characterIDs.at(c));
+        if (stateSet == 0) {
+            row.append((char)flags);
+            continue;
+        }
+        row.append((char)(flags | stateSetFollows));
+        while (stateSet >= 0x80) {
+            row.append((char)((stateSet & 0x7F) | 0x80));
+            stateSet >>= 7;
+        }
+        row.append((char)stateSet);
+    }
+    // Level 1, the rows are small and saving speed matters more than the last few percent
+    return qCompress(row, 1);
+}
+
+// INSERT INTO table(columns) VALUES (?,?),(?,?),... for rowCount rows of columnCount values
+QString Database::insertStatement(QString table, QString columns, int columnCount, int rowCount)
+{
+    QString row = "(?" + QString(",?").repeated(columnCount - 1) + ")";
+    QStringList rows;
+    for (int i = 0; i < rowCount; i++) {
+        rows.append(row);
+    }
+    return QString("INSERT INTO %1(%2) VALUES %3;").arg(table).arg(columns).arg(rows.join(","));
+}
+
+/*------------------------------------------------------------------------------------/
+ * Load
+ *-----------------------------------------------------------------------------------*/
+
+// Read the first matrix in the file into 'matrix', which is expected to be empty
+bool Database::loadMatrix(Matrix *matrix)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    query.prepare("SELECT prefix,name,description,type,missing,gap,storage,symbols FROM matrices ORDER BY ID LIMIT 1;");
+    if (!execute(query)) {
+        return false;
+    }
+    if (!query.next()) {
+        errorText = "The file does not hold a matrix.";
+        return false;
+    }
+    QString prefix = query.value(0).toString();
+    matrix->matrixName = query.value(1).toString();
+    matrix->matrixDescription = query.value(2).toString();
+    matrix->matrixType = query.value(3).toInt();
+    matrix->missingCharacter = query.value(4).toString();
+    matrix->gapCharacter = query.value(5).toString();
+    int storage = query.value(6).toInt();
+    QString symbols = query.value(7).toString();
+    storageMode = (storage == CellStorage ? CellStorage : RowStorage);
+    query.finish();
+
+    // Taxa
+    matrix->taxonList.clear();
+    query.prepare("SELECT TID,name,notes,enabled FROM "+prefix+"_taxa ORDER BY position;");
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        Taxon taxon(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString());
+        taxon.setIsEnabled(query.value(3).toInt() != 0);
+        matrix->taxonList.append(taxon);
+    }
+    query.finish();
+
+    // Characters, then their states
+    QHash<int,int> characterIndex;
+    matrix->characterList.clear();
+    query.prepare("SELECT CID,name,notes,enabled,eliminated,ordered FROM "+prefix+"_characters ORDER BY position;");
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        Character character(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString());
+        character.setIsEnabled(query.value(3).toInt() != 0);
+        character.setIsEliminated(query.value(4).toInt() != 0);
+        character.setIsOrdered(query.value(5).toInt() != 0);
+        characterIndex.insert(character.getID(), matrix->characterList.count());
+        matrix->characterList.append(character);
+    }
+    query.finish();
+
+    query.prepare("SELECT CID,symbol,name,notes FROM "+prefix+"_states ORDER BY CID,state;");
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        int index = characterIndex.value(query.value(0).toInt(), -1);
+        if (index != -1) {
+            matrix->characterList[index].addState(query.value(1).toString(), query.value(2).toString(), query.value(3).toString());
+        }
+    }
+    query.finish();
+
+    // Equates
+    matrix->equateList.clear();
+    query.prepare("SELECT EID,symbol,equivalent,enabled FROM "+prefix+"_equates ORDER BY EID;");
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        Equate equate(query.value(0).toInt(), query.value(1).toString(), query.value(2).toString());
+        equate.setIsEnabled(query.value(3).toInt() != 0);
+        matrix->equateList.append(equate);
+    }
+    query.finish();
+
+    // Cells go straight into the grid
+    matrix->matrixGrid.clear();
+    matrix->matrixGrid.setMissingSymbol(matrix->missingCharacter);
+    matrix->matrixGrid.setGapSymbol(matrix->gapCharacter);
+    matrix->matrixGrid.reserve(matrix->taxonList.count(), matrix->characterList.count());
+    matrix->cellNotesTable.clear();
+
+    if (storage == CellStorage) {
+        return loadCells(matrix, prefix);
+    }
+    return (loadRows(matrix, prefix, symbols, INT_MIN, INT_MAX) && loadNotes(matrix, prefix, INT_MIN, INT_MAX));
+}
+
+// Reload the stored cells and notes of the taxa with IDs firstTaxonID to lastTaxonID into a loaded matrix, reading
+// only those rows of the file. Only files saved with RowStorage have per taxon rows.
+bool Database::loadTaxonRows(Matrix *matrix, int firstTaxonID, int lastTaxonID)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT prefix,storage,symbols FROM matrices ORDER BY ID LIMIT 1;");
+    if (!execute(query)) {
+        return false;
+    }
+    if (!query.next()) {
+        errorText = "The file does not hold a matrix.";
+        return false;
+    }
+    QString prefix = query.value(0).toString();
+    int storage = query.value(1).toInt();
+    QString symbols = query.value(2).toString();
+    query.finish();
+
+    if (storage != RowStorage) {
+        errorText = "The file stores one row per cell, taxa can only be loaded with the whole matrix.";
+        return false;
+    }
+
+    QHash<QPair<int,int>, QString>::iterator i = matrix->cellNotesTable.begin();
+    while (i != matrix->cellNotesTable.end()) {
+        if (i.key().first >= firstTaxonID && i.key().first <= lastTaxonID) {
+            i = matrix->cellNotesTable.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    return (loadRows(matrix, prefix, symbols, firstTaxonID, lastTaxonID) && loadNotes(matrix, prefix, firstTaxonID, lastTaxonID));
+}
+
+// One _data row per cell, each distinct state text is only parsed once
+bool Database::loadCells(Matrix *matrix, QString prefix)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    QHash<QString, QPair<quint64,int> > stateCodes;
+    query.prepare("SELECT TID,CID,state,notes FROM "+prefix+"_data;");
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        int taxonID = query.value(0).toInt();
+        int characterID = query.value(1).toInt();
+        QString state = query.value(2).toString();
+
+        QHash<QString, QPair<quint64,int> >::const_iterator code = stateCodes.constFind(state);
+        if (code == stateCodes.constEnd()) {
+            quint64 stateSet;
+            int flags;
+            if (!matrix->matrixGrid.encodeState(state, stateSet, flags)) {
+                stateSet = 0;
+                flags = MatrixGrid::MissingFlag;
+            }
+            code = stateCodes.insert(state, qMakePair(stateSet, flags));
+        }
+        matrix->matrixGrid.setCellData(taxonID, characterID, code.value().first, code.value().second);
+
+        QString notes = query.value(3).toString();
+        if (!notes.isEmpty()) {
+            matrix->cellNotesTable.insert(qMakePair(taxonID, characterID), notes);
+        }
+    }
+    query.finish();
+
+    return true;
+}
+
+// The _rows of taxa firstTaxonID to lastTaxonID, see encodeRow(). Bit n of a saved state set is symbols.at(n),
+// which is the grid's own bit n when the whole matrix is loaded into an empty grid.
+bool Database::loadRows(Matrix *matrix, QString prefix, QString symbols, int firstTaxonID, int lastTaxonID)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // Character order the rows were written in
+    QVector<int> characterIDs;
+    query.prepare("SELECT CID FROM "+prefix+"_characters WHERE slot>=0 ORDER BY slot;");
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        characterIDs.append(query.value(0).toInt());
+    }
+    query.finish();
+    QVector<int> columns = matrix->matrixGrid.columnsFor(characterIDs);
+    matrix->savedCharacterOrder = characterIDs;
+
+    // Where each saved symbol sits in this grid, adding it if it is new
+    QVector<int> symbolBits(symbols.size());
+    bool isSameOrder = true;
+    for (int i = 0; i < symbols.size(); i++) {
+        quint64 stateSet;
+        int flags;
+        matrix->matrixGrid.encodeState(QString(symbols.at(i)), stateSet, flags);
+        symbolBits[i] = matrix->matrixGrid.symbolIndex(symbols.at(i));
+        if (symbolBits.at(i) != i) {
+            isSameOrder = false;
+        }
+    }
+
+    QVector<quint64> stateSets(characterIDs.count());
+    QVector<quint8> flags(characterIDs.count());
+    query.prepare("SELECT TID,data FROM "+prefix+"_rows WHERE TID BETWEEN ? AND ? ORDER BY TID;");
+    query.bindValue(0, firstTaxonID);
+    query.bindValue(1, lastTaxonID);
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        QByteArray row = qUncompress(query.value(1).toByteArray());
+        const uchar *data = (const uchar *)row.constData();
+        const uchar *end = data + row.size();
+
+        int count = 0;
+        while (data < end && count < characterIDs.count()) {
+            int header = *data++;
+            quint64 stateSet = 0;
+            if (header & stateSetFollows) {
+                int shift = 0;
+                while (data < end) {
+                    uchar byte = *data++;
+                    stateSet |= (quint64)(byte & 0x7F) << shift;
+                    shift += 7;
+                    if (!(byte & 0x80)) {
+                        break;
+                    }
+                }
+            }
+            if (!isSameOrder) {
+                quint64 savedSet = stateSet;
+                stateSet = 0;
+                for (int bit = 0; bit < symbolBits.count(); bit++) {
+                    if ((savedSet & ((quint64)1 << bit)) && symbolBits.at(bit) != -1) {
+                        stateSet |= (quint64)1 << symbolBits.at(bit);
+                    }
+                }
+            }
+            stateSets[count] = stateSet;
+            flags[count] = header & ~stateSetFollows;
+            count++;
+        }
+        matrix->matrixGrid.setRowData(query.value(0).toInt(), columns, 0, count, stateSets.constData(), flags.constData());
+    }
+    query.finish();
+
+    return true;
+}
+
+// The _notes of taxa firstTaxonID to lastTaxonID
+bool Database::loadNotes(Matrix *matrix, QString prefix, int firstTaxonID, int lastTaxonID)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT TID,CID,notes FROM "+prefix+"_notes WHERE TID BETWEEN ? AND ?;");
+    query.bindValue(0, firstTaxonID);
+    query.bindValue(1, lastTaxonID);
+    if (!execute(query)) {
+        return false;
+    }
+    while (query.next()) {
+        matrix->cellNotesTable.insert(qMakePair(query.value(0).toInt(), query.value(1).toInt()), query.value(2).toString());
+    }
+    query.finish();
+
+    return true;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Query Helpers
+ *-----------------------------------------------------------------------------------*/
+
+bool Database::execute(QString sql)
+{
+    QSqlQuery query(db);
+    if (!query.exec(sql)) {
+        return fail(query.lastError());
+    }
+    return true;
+}
+
+bool Database::execute(QSqlQuery &query)
+{
+    if (!query.exec()) {
+        return fail(query.lastError());
+    }
+    return true;
+}
+
+// Keep the error for lastError(), always returns false
+bool Database::fail(QSqlError error)
+{
+    errorText = error.text();
+    qDebug() << "SQLite: Error -" << error;
+    return false;
 }
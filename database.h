@@ -24,22 +24,68 @@
 #include <QDateTime>
 
 #include <settings.h>
+#include "matrixgrid.h"
 
 class Settings;
+class Matrix;
 
+// A .made file. Each file is an SQLite database holding a settings table, a matrices table and one set of
+// <prefix>_taxa, _characters, _states and _equates tables per matrix. Cells are either one _data row each
+// (CellStorage) or, by default, one compressed _rows BLOB per taxon with the notes kept apart in _notes
+// (RowStorage). A matrix is saved in a single
+// transaction with prepared statements that are reused for every row, cells going in many rows per INSERT, and is
+// loaded with forward only queries straight into the Matrix's lists and grid.
 class Database
 {
 public:
     Database();
+    ~Database();
+
+    bool open(QString fileName);
+    void close();
+    QString lastError();
+
     void setSetting(QString name, QString value);
     QString getSetting(QString name);
 
-    void newMatrix();
+    enum StorageMode {
+        CellStorage = 0,
+        RowStorage = 1
+    };
+
+    void setStorageMode(StorageMode mode);
+    StorageMode getStorageMode();
+
+    bool saveMatrix(Matrix *matrix);
+    bool saveChanges(Matrix *matrix);
+    bool loadMatrix(Matrix *matrix);
+    bool loadTaxonRows(Matrix *matrix, int firstTaxonID, int lastTaxonID);
 
 private:
     QSqlDatabase db;
-    Settings *settings;
-    void createSchema();
+    QString connectionName;
+    QString errorText;
+    StorageMode storageMode;
+
+    enum { cellsPerInsert = 200 };  // rows per INSERT into _data, 4 values each stays under SQLite's 999 variables
+    enum { stateSetFollows = 0x80 };  // cell byte of a _rows BLOB, the flags are the low bits
+
+    bool createSchema();
+    bool newMatrix(QString tablePrefix);
+    bool execute(QString sql);
+    bool execute(QSqlQuery &query);
+    bool fail(QSqlError error);
+    bool saveCells(Matrix *matrix, QString prefix);
+    bool saveTaxa(Matrix *matrix, QString prefix, bool isAll);
+    bool saveCharacters(Matrix *matrix, QString prefix, QVector<int> rowOrder, bool isAll);
+    bool saveEquates(Matrix *matrix, QString prefix);
+    bool saveRows(Matrix *matrix, QString prefix, QVector<int> rowOrder, bool isAll);
+    bool saveNotes(Matrix *matrix, QString prefix, bool isAll);
+    QByteArray encodeRow(MatrixGrid &grid, int taxonID, const QVector<int> &characterIDs);
+    bool loadCells(Matrix *matrix, QString prefix);
+    bool loadRows(Matrix *matrix, QString prefix, QString symbols, int firstTaxonID, int lastTaxonID);
+    bool loadNotes(Matrix *matrix, QString prefix, int firstTaxonID, int lastTaxonID);
+    QString insertStatement(QString table, QString columns, int columnCount, int rowCount);
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,197 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "logsink.h"
+
+LogSink::LogSink(QTextBrowser *browser, QObject *parent) :
+    QObject(parent)
+{
+    logBrowser = browser;
+    minimumLevel.storeRelease(Info);
+    ringStart = 0;
+    ringCount = 0;
+    pendingCount = 0;
+    droppedCount = 0;
+    setCapacity(5000);
+
+    flushTimer = new QTimer(this);
+    flushTimer->setInterval(250);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+    flushTimer->start();
+}
+
+/*------------------------------------------------------------------------------------/
+ * Level and Capacity
+ *-----------------------------------------------------------------------------------*/
+
+void LogSink::setLevel(Level level)
+{
+    minimumLevel.storeRelease(level);
+}
+
+LogSink::Level LogSink::getLevel()
+{
+    return (Level)minimumLevel.loadAcquire();
+}
+
+// Number of entries kept, both in the ring and as paragraphs in the log browser. Resizing keeps the newest.
+void LogSink::setCapacity(int entries)
+{
+    QMutexLocker locker(&mutex);
+
+    QVector<Entry> kept;
+    int first = qMax(0, ringCount - entries);
+    for (int i = first; i < ringCount; i++) {
+        kept.append(ringAt(i));
+    }
+
+    ring = kept;
+    ring.resize(entries);
+    ringStart = 0;
+    ringCount = kept.count();
+    pendingCount = qMin(pendingCount, ringCount);
+
+    logBrowser->document()->setMaximumBlockCount(entries);
+}
+
+int LogSink::getCapacity()
+{
+    QMutexLocker locker(&mutex);
+    return ring.count();
+}
+
+/*------------------------------------------------------------------------------------/
+ * Entries
+ *-----------------------------------------------------------------------------------*/
+
+void LogSink::append(Level level, QString title, QString message)
+{
+    if (!isLogged(level)) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+
+    // Fold a repeat of the last message into it while it is still waiting to be shown
+    if (pendingCount > 0) {
+        Entry &last = ringAt(ringCount-1);
+        if (last.level == level && last.message == message && last.title == title) {
+            last.repeats++;
+            last.time = QDateTime::currentDateTime();
+            return;
+        }
+    }
+
+    Entry entry;
+    entry.time = QDateTime::currentDateTime();
+    entry.level = level;
+    entry.title = title;
+    entry.message = message;
+    entry.repeats = 1;
+
+    if (ringCount < ring.count()) {
+        ringAt(ringCount) = entry;
+        ringCount++;
+    } else {
+        // Full, the oldest entry makes way
+        ring[ringStart] = entry;
+        ringStart = (ringStart + 1) % ring.count();
+    }
+
+    if (pendingCount < ringCount) {
+        pendingCount++;
+    } else {
+        // The oldest pending entry was overwritten before it could be shown
+        droppedCount++;
+    }
+}
+
+// Copy of the entries held, oldest first
+QList<LogSink::Entry> LogSink::recentEntries()
+{
+    QMutexLocker locker(&mutex);
+
+    QList<Entry> entries;
+    for (int i = 0; i < ringCount; i++) {
+        entries.append(ringAt(i));
+    }
+    return entries;
+}
+
+LogSink::Entry &LogSink::ringAt(int index)
+{
+    return ring[(ringStart + index) % ring.count()];
+}
+
+/*------------------------------------------------------------------------------------/
+ * Log Browser
+ *-----------------------------------------------------------------------------------*/
+
+// Show everything appended since the last flush with a single append to the log browser
+void LogSink::flush()
+{
+    QList<Entry> entries;
+    int dropped;
+    {
+        QMutexLocker locker(&mutex);
+        if (pendingCount == 0) {
+            return;
+        }
+        for (int i = ringCount - pendingCount; i < ringCount; i++) {
+            entries.append(ringAt(i));
+        }
+        dropped = droppedCount;
+        pendingCount = 0;
+        droppedCount = 0;
+    }
+
+    QStringList html;
+    if (dropped > 0) {
+        Entry entry;
+        entry.time = entries.first().time;
+        entry.level = Warning;
+        entry.title = "Log";
+        entry.message = tr("%1 messages were discarded to keep up.").arg(dropped);
+        entry.repeats = 1;
+        html.append(entryHtml(entry));
+    }
+    for (int i = 0; i < entries.count(); i++) {
+        html.append(entryHtml(entries[i]));
+    }
+
+    logBrowser->append(html.join("<br>"));
+}
+
+QString LogSink::entryHtml(Entry &entry)
+{
+    QString message = entry.message;
+    if (entry.repeats > 1) {
+        message += tr(" (repeated %1 times)").arg(entry.repeats);
+    }
+
+    QString html = tr("<div><span>%1</span> - <span><b>%2:</b> <i>%3</i></span></div>")
+            .arg(entry.time.toString())
+            .arg(entry.title)
+            .arg(message);
+
+    if (entry.level == Warning) {
+        html = QString("<font color=\"#996600\">%1</font>").arg(html);
+    } else if (entry.level == Error) {
+        html = QString("<font color=\"#990000\">%1</font>").arg(html);
+    }
+    return html;
+}
@@ -0,0 +1,79 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QtWidgets>
+
+// Application log. Messages are kept in a bounded ring buffer and shown in the log browser in batches on
+// a timer, so a burst of messages costs one append to the browser rather than one per message. A message
+// identical to the one before it is folded into it as a repeat count. append() may be called from any
+// thread; messages below the current level are dropped, and isLogged() lets callers skip building them.
+class LogSink : public QObject
+{
+    Q_OBJECT
+
+public:
+    LogSink(QTextBrowser *browser, QObject *parent = 0);
+
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    struct Entry {
+        QDateTime time;
+        Level level;
+        QString title;
+        QString message;
+        int repeats;
+    };
+
+    void setLevel(Level level);
+    Level getLevel();
+    bool isLogged(Level level) { return (int)level >= minimumLevel.loadAcquire(); }
+
+    void append(Level level, QString title, QString message);
+    QList<Entry> recentEntries();
+
+    void setCapacity(int entries);
+    int getCapacity();
+
+public slots:
+    void flush();
+
+private:
+    QTextBrowser *logBrowser;
+    QTimer *flushTimer;
+    QAtomicInt minimumLevel;
+
+    // Ring of the most recent entries, the newest pendingCount of which have not been shown yet
+    QMutex mutex;
+    QVector<Entry> ring;
+    int ringStart;
+    int ringCount;
+    int pendingCount;
+    int droppedCount;
+
+    Entry &ringAt(int index);
+    QString entryHtml(Entry &entry);
+};
+
+#endif // LOGSINK_H
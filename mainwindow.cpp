@@ -24,6 +24,13 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
     mainwindow = this;
+    logSink = new LogSink(ui->logTextBrowser, this);
+    activeMatrix = 0;
+    importThread = 0;
+    importProgressDialog = 0;
+    importProgressTimer = new QTimer(this);
+    importProgressTimer->setInterval(100);
+    connect(importProgressTimer, SIGNAL(timeout()), this, SLOT(importNexusProgress()));
 
     //setDockOptions(QMainWindow::VerticalTabs);
     tabifyDockWidget(ui->infoDockWidget, ui->taxaListDockWidget);
@@ -38,6 +45,11 @@ MainWindow::MainWindow(QWidget *parent) :
     settings->mw = this;
     settings->initialize();
 
+    QVariant logLevel = settings->getSetting("logLevel");
+    if (logLevel.isValid()) {
+        logSink->setLevel((LogSink::Level)logLevel.toInt());
+    }
+
     enabledColor.setRgba(settings->getSetting("enabledColor").toUInt());
     disabledColor.setRgba(settings->getSetting("disabledColor").toUInt());
 
@@ -53,10 +65,15 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Contect Matrix Mdi Child to MainWindow to catch change in focus
     connect(ui->mdiArea, SIGNAL(subWindowActivated(QMdiSubWindow*)), this, SLOT(updateMainWindow()));
+
+    // Offer back any unsaved changes from a session that did not close properly, once the window is up
+    QTimer::singleShot(0, this, SLOT(recoverAutosaves()));
 }
 
 MainWindow::~MainWindow()
 {
+    // Write out any settings still waiting on the write-behind timer
+    settings->flush();
     delete ui;
 }
 
@@ -66,12 +83,7 @@ MainWindow::~MainWindow()
 
 void MainWindow::logAppend(const QString &strTitle, const QString &strMessage)
 {
-    QDateTime dateTime = QDateTime::currentDateTime();
-    QString dateTimeString = dateTime.toString();
-    ui->logTextBrowser->append(tr("<div><span>%1</span> - <span><b>%2:</b> <i>%3</i></span></div>")
-                               .arg(dateTimeString)
-                               .arg(strTitle)
-                               .arg(strMessage));
+    logSink->append(LogSink::Info, strTitle, strMessage);
 }
 
 /*------------------------------------------------------------------------------------/
@@ -81,9 +93,7 @@ void MainWindow::logAppend(const QString &strTitle, const QString &strMessage)
 //---- Create a new Matrix Mdi Child
 Matrix *MainWindow::createMatrix()
 {
-    Matrix *child = new Matrix;
-    child->mw = mainwindow;
-    child->settings = settings;
+    Matrix *child = new Matrix(mainwindow, settings);
     ui->mdiArea->addSubWindow(child);
     logAppend("Matrix (Mdi Child)","initialized.");
     return child;
@@ -132,6 +142,7 @@ void MainWindow::updateMainWindow()
         updateTaxaDock();
         updateCharacterDock();
         updateDataDock();
+        updateEditMenu();
         ui->addEditTaxonToolButton->setEnabled(true);
         ui->addEditCharacterToolButton->setEnabled(true);
     } else {
@@ -144,6 +155,7 @@ void MainWindow::updateMainWindow()
         initializeTaxaDock();
         initializeCharacterDock();
         initializeDataDock();
+        updateEditMenu();
         ui->addEditTaxonToolButton->setEnabled(false);
         ui->addEditCharacterToolButton->setEnabled(false);
     }
@@ -168,6 +180,10 @@ void MainWindow::initializeMainMenu()
     connect(ui->actionSave, SIGNAL(triggered()), this, SLOT(saveFile()));
     connect(ui->actionSaveAs, SIGNAL(triggered()), this, SLOT(saveFileAs()));
     connect(ui->actionImportNEXUS, SIGNAL(triggered()), this, SLOT(importNexus()));
+    connect(ui->actionValidateNEXUS, SIGNAL(triggered()), this, SLOT(validateNexus()));
+    connect(ui->actionBenchmarkNEXUS, SIGNAL(triggered()), this, SLOT(benchmarkNexus()));
+    connect(ui->actionUndo, SIGNAL(triggered()), this, SLOT(undo()));
+    connect(ui->actionRedo, SIGNAL(triggered()), this, SLOT(redo()));
     connect(ui->actionSettings, SIGNAL(triggered()), this, SLOT(settingsDialogOpen()));
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(about()));
     connect(actionTile, SIGNAL(triggered()), ui->mdiArea, SLOT(tileSubWindows()));
@@ -178,6 +194,40 @@ void MainWindow::initializeMainMenu()
     connect(ui->editMatrixSettingsToolButton, SIGNAL(clicked()), this, SLOT(matrixSettingsDialogOpen()));
 }
 
+//---- Update "Edit" Main Menu from the active matrix's undo history
+void MainWindow::updateEditMenu()
+{
+    if (activeMatrix && activeMatrix->canUndo()) {
+        ui->actionUndo->setEnabled(true);
+        ui->actionUndo->setText(tr("Undo %1").arg(activeMatrix->undoText()));
+    } else {
+        ui->actionUndo->setEnabled(false);
+        ui->actionUndo->setText(tr("Undo"));
+    }
+
+    if (activeMatrix && activeMatrix->canRedo()) {
+        ui->actionRedo->setEnabled(true);
+        ui->actionRedo->setText(tr("Redo %1").arg(activeMatrix->redoText()));
+    } else {
+        ui->actionRedo->setEnabled(false);
+        ui->actionRedo->setText(tr("Redo"));
+    }
+}
+
+void MainWindow::undo()
+{
+    if (activeMatrix) {
+        activeMatrix->undo();
+    }
+}
+
+void MainWindow::redo()
+{
+    if (activeMatrix) {
+        activeMatrix->redo();
+    }
+}
+
 //---- Update "Windows" Main Menu on open
 void MainWindow::updateWindowMenu()
 {
@@ -222,6 +272,7 @@ void MainWindow::initializeInformationDock()
     ui->gapCharacterText->setText("Undefined");
     ui->taxaNumberText->setText("Undefined");
     ui->unknownCharacterText->setText("Undefined");
+    ui->memoryUsageText->setText("Undefined");
 
     ui->editMatrixSettingsToolButton->setEnabled(false);
 }
@@ -239,6 +290,7 @@ void MainWindow::updateInformationDock()
     ui->gapCharacterText->setText(QString("%1").arg(activeMatrix->getGapCharacter()));
     ui->taxaNumberText->setText(QString("%1").arg(taxaNumber));
     ui->unknownCharacterText->setText(activeMatrix->getMissingCharacter());
+    ui->memoryUsageText->setText(QString("%1 KB").arg(activeMatrix->memoryUsage()/1024));
 
     ui->editMatrixSettingsToolButton->setEnabled(true);
 }
@@ -481,6 +533,7 @@ void MainWindow::initializeDataDock()
 {
     ui->dataTaxonText->setText("No Data Selected");
     ui->dataCharacterText->setText("No Data Selected");
+    ui->dataNotesText->setText("No Data Selected");
 
     // Default States Table
     ui->dataStatesTableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
@@ -494,16 +547,23 @@ void MainWindow::initializeDataDock()
 
 void MainWindow::updateDataDock()
 {    
-    int row = activeMatrix->currentSelectedCell->first;
-    int column = activeMatrix->currentSelectedCell->second;
-    int taxonID = activeMatrix->taxonList[row].getID();
-    int characterID = activeMatrix->characterList[column].getID();
+    int row = activeMatrix->currentSelectedCell.first;
+    int column = activeMatrix->currentSelectedCell.second;
+    int taxonID = activeMatrix->taxonIDAt(row);
+    int characterID = activeMatrix->characterIDAt(column);
 
     //qDebug() << "Selected Row = " << row << " Column = " << column << " | Selected TaxonID = " << taxonID << " CharacterID = " << characterID;
 
     ui->dataTaxonText->setText(QString("T%1 - %2").arg(row+1).arg(activeMatrix->taxonList[row].getLabel()));
     ui->dataCharacterText->setText(QString("C%1 - %2").arg(column+1).arg(activeMatrix->characterList[column].getLabel()));
 
+    // Notes are only looked up for the cell being shown
+    if (activeMatrix->hasCellNotes(taxonID, characterID)) {
+        ui->dataNotesText->setText(activeMatrix->cellNotes(taxonID, characterID));
+    } else {
+        ui->dataNotesText->setText(tr("[None]"));
+    }
+
     // Update States Table
     QString symbol;
 
@@ -585,6 +645,52 @@ void MainWindow::updateDataDock()
  * Actions
  *-----------------------------------------------------------------------------------*/
 
+//---- Recover Autosave Journals
+void MainWindow::recoverAutosaves()
+{
+    QStringList journals = AutosaveJournal::findOrphans();
+    for (int i = 0; i < journals.count(); i++) {
+        AutosaveJournal::Header header;
+        QList<AutosaveJournal::Record> records;
+        if (!AutosaveJournal::read(journals.at(i), header, records)) {
+            AutosaveJournal::remove(journals.at(i));
+            continue;
+        }
+
+        // A journal of a matrix that was never changed has nothing to offer
+        int changes = 0;
+        for (int r = 0; r < records.count(); r++) {
+            if (records.at(r).type != AutosaveJournal::SymbolsRecord) {
+                changes++;
+            }
+        }
+        if (changes == 0) {
+            AutosaveJournal::remove(journals.at(i));
+            continue;
+        }
+
+        logAppend("Autosave", QString("found %1 unsaved changes to \"%2\".").arg(changes).arg(header.title));
+        QMessageBox::StandardButton answer = QMessageBox::question(
+                    this, tr("Recover Unsaved Changes"),
+                    tr("MaDE did not close properly while \"%1\" was open.\n\nRecover its %2 unsaved change(s) from %3?")
+                    .arg(QFileInfo(header.title).fileName())
+                    .arg(changes)
+                    .arg(header.created.toString("yyyy-MM-dd hh:mm:ss")),
+                    QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+
+        if (answer == QMessageBox::Yes) {
+            Matrix *child = createMatrix();
+            if (child->recoverFile(journals.at(i))) {
+                child->show();
+                continue;
+            }
+            child->close();
+        }
+        logAppend("Autosave", QString("unsaved changes to \"%1\" discarded.").arg(header.title));
+        AutosaveJournal::remove(journals.at(i));
+    }
+}
+
 //---- Action to Call new Matrix Mdi Child
 void MainWindow::newFile()
 {
@@ -643,10 +749,28 @@ void MainWindow::saveFileAs()
         statusBar()->showMessage(tr("File saved!"), 2000);
 }
 
-// Import NEXUS file
+// Import NEXUS file, the file is read on an import thread so the window stays responsive and the import can be
+// cancelled from the progress dialog
 void MainWindow::importNexus()
 {
     logAppend("Action","import NEXUS file...");
+    startNexusImport(false);
+}
+
+// Check a NEXUS file without importing it, every error found is listed once the whole file has been read
+void MainWindow::validateNexus()
+{
+    logAppend("Action","validate NEXUS file...");
+    startNexusImport(true);
+}
+
+void MainWindow::startNexusImport(bool validate)
+{
+    if (importThread) {
+        logAppend("Action","a NEXUS file is already being imported.");
+        return;
+    }
+
     QFileDialog dialog;
     dialog.setFileMode(QFileDialog::ExistingFile);
     dialog.setNameFilter("NEXUS (*.nex)");
@@ -655,45 +779,163 @@ void MainWindow::importNexus()
         QStringList filenames = dialog.selectedFiles();
         QString filename = filenames[0];
         if (!filename.isEmpty()) {
-            QFile file(filename);
-            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                logAppend("Action","Unable to open .nex file in readonly text mode.");
-            } else {
-                QTextStream iStream(&file);
+            importThread = new NexusImportThread(mainwindow, settings, filename, this);
+            if (!importThread->open()) {
+                logAppend("Action","Unable to open .nex file in readonly mode.");
+                delete importThread;
+                importThread = 0;
+                return;
+            }
 
-                // New nexusReader(mainwindow, settings)
-                NexusParserReader nexusParser(mainwindow, settings);
+            // Add Block Reader
+            NexusParserReader *nexusParser = importThread->getReader();
+            nexusParser->addBlock("TAXA");
+            nexusParser->addBlock("ASSUMPTIONS");
+            nexusParser->addBlock("CHARACTERS");
+            //nexusParser->addBlock("NOTES");
+            nexusParser->setValidating(validate);
+
+            QString text = (validate ? tr("Validating %1...") : tr("Reading %1..."));
+            importProgressDialog = new QProgressDialog(text.arg(QFileInfo(filename).fileName()), tr("Cancel"), 0, 1000, this);
+            importProgressDialog->setWindowModality(Qt::WindowModal);
+            importProgressDialog->setAutoClose(false);
+            importProgressDialog->setAutoReset(false);
+            connect(importProgressDialog, SIGNAL(canceled()), this, SLOT(importNexusCancel()));
+
+            connect(importThread, SIGNAL(finished()), this, SLOT(importNexusFinished()));
+            importThread->start();
+            importProgressTimer->start();
+        }
+    } else {
+        logAppend("Action","import NEXUS file canceled.");
+    }
+}
 
-                // New NexusParserToken token(QTextStream);
-                NexusParserToken token(iStream);
+// Poll the import thread's progress into the progress dialog
+void MainWindow::importNexusProgress()
+{
+    if (!importThread || !importProgressDialog) {
+        return;
+    }
 
-                // Add Block Reader
-                nexusParser.addBlock("TAXA");
-                nexusParser.addBlock("ASSUMPTIONS");
-                nexusParser.addBlock("CHARACTERS");
-                //nexusParser.addBlock("NOTES");
+    qint64 fileSize = importThread->getFileSize();
+    if (fileSize > 0) {
+        importProgressDialog->setValue((int)((importThread->getBytesRead() * 1000) / fileSize));
+    }
+    importProgressDialog->setLabelText(tr("Reading %1... %2 rows")
+                                       .arg(QFileInfo(importThread->getFileName()).fileName())
+                                       .arg(importThread->getRowsRead()));
+}
 
-                if(nexusParser.execute(token)) {
-                    // Create New Matrix from data
-                    if (nexusParser.getBlockCount("TAXA") != 0) {
+void MainWindow::importNexusCancel()
+{
+    if (importThread) {
+        logAppend("Action","canceling NEXUS import...");
+        importThread->cancel();
+    }
+}
 
-                    }
-                    if (nexusParser.getBlockCount("CHARACTERS") != 0) {
+// Back on the GUI thread once the reader has returned
+void MainWindow::importNexusFinished()
+{
+    importProgressTimer->stop();
+    if (importProgressDialog) {
+        importProgressDialog->disconnect(this);
+        importProgressDialog->deleteLater();
+        importProgressDialog = 0;
+    }
 
-                    }
+    NexusImportThread *thread = importThread;
+    importThread = 0;
 
-                } else {
-                    logAppend("Action","import NEXUS file aborted by NEXUS Reader.");
-                }
-            file.close();
-            }
+    if (thread->getIsCancelled()) {
+        logAppend("Action","import NEXUS file canceled.");
+    } else if (thread->getReader()->isValidating()) {
+        showNexusIssues(thread);
+    } else if (thread->getIsExecuted()) {
+        NexusParserReader *nexusParser = thread->getReader();
+
+        // Create New Matrix from data, the last CHARACTERS block read along with its TAXA block
+        if (nexusParser->getBlockCount("CHARACTERS") != 0) {
+            NexusParserCharactersBlock *charactersBlock = static_cast<NexusParserCharactersBlock *>(nexusParser->getUsedBlocks().value("CHARACTERS").last());
+            Matrix *child = createMatrix();
+            child->importNexus(QFileInfo(thread->getFileName()).completeBaseName(), charactersBlock);
+            child->show();
+        } else {
+            logAppend("Action","no CHARACTERS block found, nothing to import.");
         }
     } else {
-        logAppend("Action","import NEXUS file canceled.");
+        logAppend("Action","import NEXUS file aborted by NEXUS Reader.");
     }
+
+    thread->deleteLater();
 }
 
 
+// Report the outcome of a validation run, the full list of issues goes in the dialog's details
+void MainWindow::showNexusIssues(NexusImportThread *thread)
+{
+    NexusParserReader *nexusParser = thread->getReader();
+    QList<NexusParserIssue> issues = nexusParser->getIssues();
+    int errors = nexusParser->countErrors();
+    int warnings = issues.count() - errors;
+
+    QString summary = tr("%1 error(s) and %2 warning(s) found in %3.")
+            .arg(errors)
+            .arg(warnings)
+            .arg(QFileInfo(thread->getFileName()).fileName());
+    logAppend("Validate NEXUS", summary);
+
+    QStringList details;
+    for (int i = 0; i < issues.count(); i++) {
+        details.append(tr("%1 line %2, column %3 (byte %4): %5")
+                       .arg(issues.at(i).isError ? tr("ERROR") : tr("WARNING"))
+                       .arg(issues.at(i).fileLine)
+                       .arg(issues.at(i).fileCol)
+                       .arg(issues.at(i).filePos)
+                       .arg(issues.at(i).message));
+    }
+
+    QMessageBox messageBox(this);
+    messageBox.setWindowTitle(tr("Validate NEXUS"));
+    messageBox.setIcon(errors > 0 ? QMessageBox::Warning : QMessageBox::Information);
+    messageBox.setText(summary);
+    if (!details.isEmpty()) {
+        messageBox.setDetailedText(details.join("\n"));
+    }
+    messageBox.exec();
+}
+
+// Time the NEXUS reader on generated files, the figures go to the log and a summary dialog
+void MainWindow::benchmarkNexus()
+{
+    if (importThread) {
+        logAppend("Benchmark","a NEXUS file is being imported, try again once it has finished.");
+        return;
+    }
+    logAppend("Benchmark","running NEXUS reader benchmark...");
+
+    QProgressDialog progress(tr("Benchmarking..."), tr("Cancel"), 0, 1, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(0);
+
+    NexusBenchmark benchmark(mainwindow, settings);
+    QList<NexusBenchmark::Result> results = benchmark.run(&progress);
+
+    QStringList lines;
+    for (int i = 0; i < results.count(); i++) {
+        lines.append(benchmark.formatResult(results[i]));
+        logAppend("Benchmark", lines.last());
+    }
+
+    QMessageBox messageBox(this);
+    messageBox.setWindowTitle(tr("Benchmark NEXUS Reader"));
+    messageBox.setIcon(QMessageBox::Information);
+    messageBox.setText(tr("%1 of %2 cases run.").arg(results.count()).arg(benchmark.cases().count()));
+    messageBox.setDetailedText(lines.join("\n"));
+    messageBox.exec();
+}
+
 //---- Settings:
 void MainWindow::settingsDialogOpen()
 {
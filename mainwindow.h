@@ -28,6 +28,9 @@
 #include "matrix.h"
 #include "nexusparser.h"
 #include "settingsdialog.h"
+#include "nexusimportthread.h"
+#include "logsink.h"
+#include "nexusbenchmark.h"
 
 class Matrix;
 class QAction;
@@ -51,8 +54,7 @@ public:
 
     MainWindow *mainwindow;
     Settings *settings;
-
-    void logAppend(const QString &strTitle, const QString &strMessage);
+    LogSink *logSink;
 
     void updateInformationDock();
 
@@ -70,6 +72,11 @@ public:
 
     void updateDataDock();
 
+    void updateEditMenu();
+
+public slots:
+    void logAppend(const QString &strTitle, const QString &strMessage);
+
 private:
 
     QSignalMapper *windowMapper;
@@ -85,6 +92,13 @@ private:
     QColor enabledColor;
     QColor disabledColor;
 
+    NexusImportThread *importThread;
+    QProgressDialog *importProgressDialog;
+    QTimer *importProgressTimer;
+
+    void startNexusImport(bool validate);
+    void showNexusIssues(NexusImportThread *thread);
+
     void initializeMainMenu();
     void initializeInformationDock();
     void initializeDataDock();
@@ -103,6 +117,14 @@ private slots:
     void saveFile();
     void saveFileAs();
     void importNexus();
+    void validateNexus();
+    void benchmarkNexus();
+    void recoverAutosaves();
+    void importNexusProgress();
+    void importNexusCancel();
+    void importNexusFinished();
+    void undo();
+    void redo();
     void settingsDialogOpen();
     void matrixSettingsDialogOpen();
     void matrixTaxaDialogOpen();    
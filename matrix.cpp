@@ -22,9 +22,15 @@
 #include "matrixsettingsdialog.h"
 #include "taxadialog.h"
 #include "charactersdialog.h"
+#include "matrixcelldelegate.h"
+#include "database.h"
 
-Matrix::Matrix()
+Matrix::Matrix(MainWindow *mainwindow, Settings *mainSettings)
 {
+    // Needed before the defaults below are read from the settings
+    mw = mainwindow;
+    settings = mainSettings;
+
     setupUi(this);
 
     setAttribute(Qt::WA_DeleteOnClose);
@@ -36,9 +42,20 @@ Matrix::Matrix()
     isUntitled = true;
     isModified = false;
     isSelected = false;
+    resetDirtyRegions(false);
+    autosaveJournal = 0;
+    isAutosaveOff = false;
+    isReplaying = false;
+    journaledSymbols = 0;
     nextCharacterID = 0;
     nextTaxonID = 0;
-    previousSelectedCell = currentSelectedCell = new QPair<int,int>(0,0);
+    taxonIndexDirtyFrom = -1;
+    characterIndexDirtyFrom = -1;
+    batchDepth = 0;
+    isBatchUpdate = false;
+    hasBatchItemChanged = false;
+    progress = 0;
+    previousSelectedCell = currentSelectedCell = qMakePair(0,0);
     previousSelectedCellColor = QBrush(Qt::transparent);
     currentSelectedCellColor = QBrush(QColor(176,196,222));
     currentSelectedCellData = missingCharacter;
@@ -53,17 +70,27 @@ Matrix::Matrix()
     matrixTypesList = settings->getSetting("defaultMatrixTypes").toList();
     stateSetList = settings->getSetting("defaultStandardStateSet").toList();
 
+    matrixGrid.setMissingSymbol(missingCharacter);
+    matrixGrid.setGapSymbol(gapCharacter);
+
     initializeMatrixTable();
 }
 
-
 /*------------------------------------------------------------------------------------/
  * Matrix Table Functions
  *-----------------------------------------------------------------------------------*/
 
 void Matrix::initializeMatrixTable()
 {
-    matrix->matrixRightTableWidget->setContextMenuPolicy(Qt::CustomContextMenu);
+    // Both tables read straight from the matrix through their models
+    leftTableModel = new MatrixTableModel(this, MatrixTableModel::TaxaTable);
+    rightTableModel = new MatrixTableModel(this, MatrixTableModel::DataTable);
+    matrix->matrixLeftTableView->setModel(leftTableModel);
+    matrix->matrixRightTableView->setModel(rightTableModel);
+    cellDelegate = new MatrixCellDelegate(matrix->matrixRightTableView);
+    matrix->matrixRightTableView->setItemDelegate(cellDelegate);
+
+    matrix->matrixRightTableView->setContextMenuPolicy(Qt::CustomContextMenu);
 
     // Add Line to Splitter
     QSplitterHandle *handle = matrix->matricTableSplitter->handle(1);
@@ -75,115 +102,55 @@ void Matrix::initializeMatrixTable()
     layout->addWidget(line);
 
     // Interconnect tables with scrollbars
-    connect(matrix->matrixTableHorizontalScrollBar, SIGNAL(valueChanged(int)), matrix->matrixRightTableWidget->horizontalScrollBar(), SLOT(setValue(int)));
-    connect(matrix->matrixRightTableWidget->horizontalScrollBar(), SIGNAL(valueChanged(int)), matrix->matrixTableHorizontalScrollBar, SLOT(setValue(int)));
-    connect(matrix->matrixRightTableWidget->horizontalScrollBar(), SIGNAL(rangeChanged(int, int)), this, SLOT(updateHorizontalScrollbarRange(int, int)));
-    connect(matrix->matrixTableVerticalScrollBar, SIGNAL(valueChanged(int)), matrix->matrixLeftTableWidget->verticalScrollBar(), SLOT(setValue(int)));
-    connect(matrix->matrixLeftTableWidget->verticalScrollBar(), SIGNAL(valueChanged(int)), matrix->matrixTableVerticalScrollBar, SLOT(setValue(int)));
+    connect(matrix->matrixTableHorizontalScrollBar, SIGNAL(valueChanged(int)), matrix->matrixRightTableView->horizontalScrollBar(), SLOT(setValue(int)));
+    connect(matrix->matrixRightTableView->horizontalScrollBar(), SIGNAL(valueChanged(int)), matrix->matrixTableHorizontalScrollBar, SLOT(setValue(int)));
+    connect(matrix->matrixRightTableView->horizontalScrollBar(), SIGNAL(rangeChanged(int, int)), this, SLOT(updateHorizontalScrollbarRange(int, int)));
+    connect(matrix->matrixTableVerticalScrollBar, SIGNAL(valueChanged(int)), matrix->matrixLeftTableView->verticalScrollBar(), SLOT(setValue(int)));
+    connect(matrix->matrixLeftTableView->verticalScrollBar(), SIGNAL(valueChanged(int)), matrix->matrixTableVerticalScrollBar, SLOT(setValue(int)));
 
-    connect(matrix->matrixTableVerticalScrollBar, SIGNAL(valueChanged(int)), matrix->matrixRightTableWidget->verticalScrollBar(), SLOT(setValue(int)));
-    connect(matrix->matrixRightTableWidget->verticalScrollBar(), SIGNAL(valueChanged(int)), matrix->matrixTableVerticalScrollBar, SLOT(setValue(int)));
-    connect(matrix->matrixRightTableWidget->verticalScrollBar(), SIGNAL(rangeChanged(int, int)), this, SLOT(updateVerticalScrollbarRange(int, int)));
+    connect(matrix->matrixTableVerticalScrollBar, SIGNAL(valueChanged(int)), matrix->matrixRightTableView->verticalScrollBar(), SLOT(setValue(int)));
+    connect(matrix->matrixRightTableView->verticalScrollBar(), SIGNAL(valueChanged(int)), matrix->matrixTableVerticalScrollBar, SLOT(setValue(int)));
+    connect(matrix->matrixRightTableView->verticalScrollBar(), SIGNAL(rangeChanged(int, int)), this, SLOT(updateVerticalScrollbarRange(int, int)));
 
     connect(matrix->matricTableSplitter, SIGNAL(splitterMoved(int, int)), this, SLOT(updateSplitter(int, int)));
 
-    matrix->matrixRightTableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
-    matrix->matrixRightTableWidget->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
-    matrix->matrixLeftTableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
-    matrix->matrixLeftTableWidget->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    matrix->matrixRightTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    matrix->matrixRightTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    matrix->matrixLeftTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    matrix->matrixLeftTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
 
     // Fix header hieght
-    matrix->matrixRightTableWidget->horizontalHeader()->setFixedHeight(20);
-    matrix->matrixLeftTableWidget->horizontalHeader()->setFixedHeight(20);
-    // Fix row hieghts
-    matrix->matrixRightTableWidget->setRowHeight(0,20);
-    matrix->matrixLeftTableWidget->setRowHeight(0,20);
-    // Fix column widths
-    matrix->matrixRightTableWidget->setColumnWidth(0,20);
+    matrix->matrixRightTableView->horizontalHeader()->setFixedHeight(20);
+    matrix->matrixLeftTableView->horizontalHeader()->setFixedHeight(20);
+    // Fix row hieghts, fixed uniform sections keep the headers independent of the matrix size
+    matrix->matrixRightTableView->verticalHeader()->setDefaultSectionSize(20);
+    matrix->matrixLeftTableView->verticalHeader()->setDefaultSectionSize(20);
 
     // Mouse actions
-    connect(matrix->matrixRightTableWidget, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(rightTableContexMenu(const QPoint&)));
+    connect(matrix->matrixRightTableView, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(rightTableContexMenu(const QPoint&)));
     initializeSelection();
 
     //Edit actions
-    connect(matrix->matrixRightTableWidget, SIGNAL(itemChanged(QTableWidgetItem *)), this, SLOT(updateRightTableCellChanged(QTableWidgetItem *)));
-    connect(matrix->matrixRightTableWidget->horizontalHeader(), SIGNAL(sectionDoubleClicked(int)), this, SLOT(horizontalHeaderRightTableDoubleClick(int)));
-    connect(matrix->matrixLeftTableWidget->verticalHeader(), SIGNAL(sectionDoubleClicked(int)), this, SLOT(verticalHeaderLeftTableDoubleClick(int)));
-    connect(matrix->matrixRightTableWidget->verticalHeader(), SIGNAL(sectionDoubleClicked(int)), this, SLOT(verticalHeaderRightTableDoubleClick(int)));
+    connect(matrix->matrixRightTableView->horizontalHeader(), SIGNAL(sectionDoubleClicked(int)), this, SLOT(horizontalHeaderRightTableDoubleClick(int)));
+    connect(matrix->matrixLeftTableView->verticalHeader(), SIGNAL(sectionDoubleClicked(int)), this, SLOT(verticalHeaderLeftTableDoubleClick(int)));
+    connect(matrix->matrixRightTableView->verticalHeader(), SIGNAL(sectionDoubleClicked(int)), this, SLOT(verticalHeaderRightTableDoubleClick(int)));
 
 }
 
-void Matrix::setupMatrixTable()
-{   
-    int taxaNumber = taxaCount();
-    int characterNumber = charactersCount();
-
-    // Add Taxa List
-    if (taxaNumber != 0) {
-        //---- Update the table view
-        for(int t = 0; t < taxaNumber; t++)
-        {
-            QString taxonName = taxonList[t].getLabel();
-            //---- Add Row
-            matrix->matrixLeftTableWidget->insertRow(t);
-            QTableWidgetItem *newItem = new QTableWidgetItem(tr("%1").arg(taxonName));
-            newItem->setFlags(Qt::ItemIsEnabled);
-            matrix->matrixLeftTableWidget->setItem(t, 0, newItem);           
-
-            totalNumberProcessed++;
-            progress->setValue(totalNumberProcessed);
-        }        
-    }
-
-    updateVerticalHeadersLeftTable();
-
-    // Add Character Headers
-    if (characterNumber != 0) {
-        //---- Update the table view
-        for(int c = 0; c < characterNumber; c++)
-        {
-            //---- Add Column
-            matrix->matrixRightTableWidget->insertColumn(c);
-            QTableWidgetItem *newItem = new QTableWidgetItem(tr("C%1").arg((c+1)));
-            newItem->setFlags(Qt::ItemIsEnabled);
-            matrix->matrixRightTableWidget->setHorizontalHeaderItem(c,newItem);
-
-            totalNumberProcessed++;
-            progress->setValue(totalNumberProcessed);
-        }
-        if (taxaNumber != 0) {
-            matrix->matrixRightTableWidget->setRowCount(taxaNumber);
-            // Add Cell Values
-            for(int t = 0; t < taxaNumber; t++)
-            {
-                // Get Taxa ID
-                int taxonID = taxonList[t].getID();
-
-                // Set Cell Data
-                for(int c = 0; c < characterNumber; c++)
-                {
-                    // Get Character ID
-                    int characterID = characterList[c].getID();
-
-                    // Lookup State Data from matrixGrid
-                    Cell *currentCell = matrixGrid.value(returnLocator(taxonID, characterID));
-                    QString currentData = currentCell->getState();
-
-                    QTableWidgetItem *newItem = new QTableWidgetItem(currentData);
-                    newItem->setFlags(Qt::ItemIsEnabled|Qt::ItemIsEditable);
-                    matrix->matrixRightTableWidget->setItem(t, c, newItem);
-                    matrix->matrixRightTableWidget->item(t,c)->setTextAlignment(Qt::AlignHCenter|Qt::AlignVCenter);
-                }
+// Called before the taxa, characters and cells of a new matrix are created
+void Matrix::beginSetupMatrixTable()
+{
+    leftTableModel->beginResetMatrix();
+    rightTableModel->beginResetMatrix();
+}
 
-                totalNumberProcessed++;
-                progress->setValue(totalNumberProcessed);
-            }
-        }
-    }
-    // Set Vertical Header
-    updateVerticalHeadersRightTable();
+// Nothing is copied into the tables, the models only pick up the new taxa and character counts
+void Matrix::setupMatrixTable()
+{
+    leftTableModel->endResetMatrix();
+    rightTableModel->endResetMatrix();
 
-    matrix->matrixRightTableWidget->item(0,0)->setBackground(currentSelectedCellColor);
+    initializeSelection();
     isSelected = true;
 }
 
@@ -192,19 +159,22 @@ void Matrix::setupMatrixTable()
  *-----------------------------------------------------------------------------------*/
 void Matrix::updateRightTableSelectionChanged(const QModelIndex & current, const QModelIndex & previous)
 {
-    isSelected = true;
-    if (previous.row() > -1 && previous.column() > -1) {
-        matrixRightTableWidget->item(previous.row(),previous.column())->setBackground(previousSelectedCellColor);
-    } else {
-        matrixRightTableWidget->item(previousSelectedCell->first, previousSelectedCell->second)->setBackground(previousSelectedCellColor);
+    if (!current.isValid()) {
+        return;
     }
-    matrixRightTableWidget->item(current.row(),current.column())->setBackground(currentSelectedCellColor);
 
+    isSelected = true;
     if (previous.row() > -1 && previous.column() > -1) {
-        previousSelectedCell = new QPair<int,int>(previous.row(),previous.column());
+        previousSelectedCell = qMakePair(previous.row(),previous.column());
     }
-    currentSelectedCell = new QPair<int,int>(current.row(),current.column());
-    currentSelectedCellData = matrix->matrixRightTableWidget->item(current.row(),current.column())->text();
+    currentSelectedCell = qMakePair(current.row(),current.column());
+
+    // Repaint the old and new selected cells
+    rightTableModel->cellChanged(previousSelectedCell.first, previousSelectedCell.second);
+    rightTableModel->cellChanged(currentSelectedCell.first, currentSelectedCell.second);
+
+    QPair<int,int> locator = cellLocator(current.row(), current.column());
+    currentSelectedCellData = cellState(locator.first, locator.second);
 
     mw->taxonListSelect(current.row());
     mw->characterListSelect(current.column());
@@ -231,28 +201,35 @@ void Matrix::horizontalHeaderRightTableDoubleClick(int column)
 
 void Matrix::initializeSelection()
 {
-    connect(matrixRightTableWidget->selectionModel(), SIGNAL(currentChanged(const QModelIndex &,const QModelIndex &)), this, SLOT(updateRightTableSelectionChanged(const QModelIndex &,const QModelIndex &)));
+    // A batch that changes the table layout selects again once it is committed
+    if (isBatchUpdate) {
+        return;
+    }
+
+    connect(matrixRightTableView->selectionModel(), SIGNAL(currentChanged(const QModelIndex &,const QModelIndex &)), this, SLOT(updateRightTableSelectionChanged(const QModelIndex &,const QModelIndex &)), Qt::UniqueConnection);
     // Set selection cell vars to 0,0
-    currentSelectedCell = new QPair<int,int>(0,0);
-    previousSelectedCell = new QPair<int,int>(0,0);
+    currentSelectedCell = qMakePair(0,0);
+    previousSelectedCell = qMakePair(0,0);
+    rightTableModel->cellChanged(0, 0);
 
     // Set selection
-    QModelIndex index = matrixRightTableWidget->model()->index(0, 0);
-    matrixRightTableWidget->selectionModel()->select(index, QItemSelectionModel::Select);
+    QModelIndex index = rightTableModel->index(0, 0);
+    matrixRightTableView->selectionModel()->select(index, QItemSelectionModel::Select);
 }
 
 void Matrix::resetSelection()
 {
-    disconnect(matrixRightTableWidget->selectionModel(), SIGNAL(currentChanged(const QModelIndex &,const QModelIndex &)), this, SLOT(updateRightTableSelectionChanged(const QModelIndex &,const QModelIndex &)));
+    disconnect(matrixRightTableView->selectionModel(), SIGNAL(currentChanged(const QModelIndex &,const QModelIndex &)), this, SLOT(updateRightTableSelectionChanged(const QModelIndex &,const QModelIndex &)));
 
-    matrixRightTableWidget->item(currentSelectedCell->first, currentSelectedCell->second)->setBackground(previousSelectedCellColor);
+    QPair<int,int> oldSelectedCell = currentSelectedCell;
 
     // Set selection none
-    currentSelectedCell = new QPair<int,int>(0,0);
-    previousSelectedCell = new QPair<int,int>(0,0);
+    currentSelectedCell = qMakePair(-1,-1);
+    previousSelectedCell = qMakePair(-1,-1);
+    rightTableModel->cellChanged(oldSelectedCell.first, oldSelectedCell.second);
 
     // Set selection
-    matrixRightTableWidget->selectionModel()->clear();
+    matrixRightTableView->selectionModel()->clear();
 }
 
 /*------------------------------------------------------------------------------------/
@@ -262,10 +239,10 @@ void Matrix::updateSplitter(int min, int max)
 {
     if (min == 0 && max != -1) {
         // Show Vertical Headers on Right Table
-        matrixRightTableWidget->verticalHeader()->show();
+        matrixRightTableView->verticalHeader()->show();
     } else {
         // Hide Vertical Headers on Right Table
-        matrixRightTableWidget->verticalHeader()->hide();
+        matrixRightTableView->verticalHeader()->hide();
     }
 }
 
@@ -291,30 +268,48 @@ void Matrix::rightTableContexMenu(const QPoint& pos)
     QMenu contextMenu(tr("Quick Edit:"), this);
 
     // List states and mark as checked/not checked
-    contextMenu.addAction(new QAction(tr("View/Edit Notes"), this));
+    QAction *notesAction = new QAction(tr("View/Edit Notes"), &contextMenu);
+    connect(notesAction, SIGNAL(triggered()), this, SLOT(editCurrentCellNotes()));
+    contextMenu.addAction(notesAction);
+
+    contextMenu.exec(matrixRightTableView->mapToGlobal(pos));
+}
+
+void Matrix::editCurrentCellNotes()
+{
+    int taxonID = taxonIDAt(currentSelectedCell.first);
+    int characterID = characterIDAt(currentSelectedCell.second);
 
-    contextMenu.exec(matrixRightTableWidget->mapToGlobal(pos));
+    bool ok;
+    QString notes = QInputDialog::getMultiLineText(this, tr("Cell Notes"),
+                                                   tr("Notes for T%1, C%2:").arg(currentSelectedCell.first+1).arg(currentSelectedCell.second+1),
+                                                   cellNotes(taxonID, characterID), &ok);
+    if (ok && notes != cellNotes(taxonID, characterID)) {
+        cellEdit(taxonID, characterID, cellState(taxonID, characterID), notes);
+        mw->updateDataDock();
+        mw->logAppend("Matrix Edit","cell notes updated.");
+    }
 }
 
 /*------------------------------------------------------------------------------------/
  * Matrix Right Table Edit Function
  *-----------------------------------------------------------------------------------*/
-void Matrix::updateRightTableCellChanged(QTableWidgetItem * item)
+// Check and store text typed into a data cell, returns false if the text was rejected
+bool Matrix::editCell(int row, int column, QString text)
 {
-    QString input = item->text();
+    QString input = text;
     input.simplified();
     input.replace(" ","");
 
     // Look up Cell Data
-    int taxonID = taxonList[item->row()].getID();
-    int characterID = characterList[item->column()].getID();
+    QPair<int,int> locator = cellLocator(row, column);
+    int taxonID = locator.first;
+    int characterID = locator.second;
 
-    Cell *currentCell = matrixGrid.value(returnLocator(taxonID, characterID));
-    QString currentState = currentCell->getState();
-    QString currentNotes = currentCell->getNotes();
+    QString currentState = cellState(taxonID, characterID);
 
     // Check new value agaist stored value
-    if (currentState != item->text()) {
+    if (currentState != text) {
         bool isError = false;
         // Do error checking here... must be a registered state and only contain the correct symbols.
         if(input.size() == 0) {
@@ -323,7 +318,7 @@ void Matrix::updateRightTableCellChanged(QTableWidgetItem * item)
         }
         if (input.size() == 1) {
             // Check against allowed states
-            if(!isSymbolAllowed(input, item->column())){
+            if(!isSymbolAllowed(input, column)){
                 mw->logAppend("Matrix Edit","error detected, data reset. Attempt to set the 'Character State' for the taxon to an illegal symbol.");
                 isError = true;
             }
@@ -358,7 +353,7 @@ void Matrix::updateRightTableCellChanged(QTableWidgetItem * item)
                 if (input.startsWith("(") && input.endsWith(")")) {
                     // It is a polymorphic state
                     for (int i = 1; i < input.size()-1; ++i) {
-                        if(!isSymbolAllowed(input.at(i), item->column())){
+                        if(!isSymbolAllowed(input.at(i), column)){
                             mw->logAppend("Matrix Edit","error detected, data reset. Attempt to set a polymorphic 'Character State' for the taxon with an illegal symbol.");
                             isError = true;
                         }
@@ -366,7 +361,7 @@ void Matrix::updateRightTableCellChanged(QTableWidgetItem * item)
                 } else if (input.startsWith("{") && input.endsWith("}")) {
                     // It is a state with uncertainty
                     for (int i = 1; i < input.size()-1; ++i) {
-                        if(!isSymbolAllowed(input.at(i), item->column())){
+                        if(!isSymbolAllowed(input.at(i), column)){
                             mw->logAppend("Matrix Edit","error detected, data reset. Attempt to set an uncertain 'Character State' for the taxon with an illegal symbol.");
                             isError = true;
                         }
@@ -374,7 +369,7 @@ void Matrix::updateRightTableCellChanged(QTableWidgetItem * item)
                 } else {
                     // Assume that it is a polymorphic state and format accordingly
                     for (int i = 0; i < input.size(); ++i) {
-                        if(!isSymbolAllowed(input.at(i), item->column())){
+                        if(!isSymbolAllowed(input.at(i), column)){
                             mw->logAppend("Matrix Edit","error detected, data reset. Attempt to set a polymorphic 'Character State' for the taxon with an illegal symbol.");
                             isError = true;
                         }
@@ -388,222 +383,175 @@ void Matrix::updateRightTableCellChanged(QTableWidgetItem * item)
 
         if (!isError) {
             // Has changed therefore update stored value and data dock
-            item->setText(input);
-            cellEdit(taxonID, characterID, item->text(), currentNotes);
+            cellEdit(taxonID, characterID, input, cellNotes(taxonID, characterID));
+            currentSelectedCellData = cellState(taxonID, characterID);
             mw->updateDataDock();
             mw->logAppend("Matrix Edit","data updated.");
         } else {
-            // There is an error replace cell value with stored
-            item->setText(currentState);
+            // There is an error, the view shows the stored value again
+            return false;
         }
     }
+    return true;
 }
 
-/*------------------------------------------------------------------------------------/
- * Matrix Left Table Text Update Function
- *-----------------------------------------------------------------------------------*/
-void Matrix::updateLeftTableText(int row, QString text)
-{
-    matrixLeftTableWidget->item(row, 0)->setText(text);
-}
 
 /*------------------------------------------------------------------------------------/
  * Matrix Table Move Row (i.e. Taxon) Up/Down Functions
  *-----------------------------------------------------------------------------------*/
 void Matrix::moveRow(int row, bool up)
 {
-    resetSelection();
-    moveRowLeftTable(row, up);
-    moveRowRightTable(row, up);
-    initializeSelection();
+    moveTaxa(row, 1, (up ? row-1 : row+1));
 }
 
-void Matrix::moveRowLeftTable(int row, bool up)
+// Move count taxa starting at row first so that the first of them ends up at row destination. Cells are
+// held by ID so no cell data moves, only the taxon order and the index entries of the rows passed over.
+bool Matrix::moveTaxa(int first, int count, int destination)
 {
-    int sourceRow = row;
-    int destRow = (up ? sourceRow-1 : sourceRow+1);
+    if (count < 1 || first < 0 || first + count > taxaCount() || destination < 0 || destination + count > taxaCount()) {
+        return false;
+    }
+    if (destination == first) {
+        return true;
+    }
 
-    // Take whole rows
-    QList<QTableWidgetItem*> sourceItems = getRowLeftTable(sourceRow);
-    QList<QTableWidgetItem*> destItems = getRowLeftTable(destRow);
+    moveTaxaBlock(first, count, destination);
 
-    // Set back in reverse order
-    setRowLeftTable(sourceRow, destItems);
-    setRowLeftTable(destRow, sourceItems);
+    MatrixJournal::Entry entry;
+    entry.type = MatrixJournal::MoveTaxa;
+    entry.text = (count == 1 ? tr("Move Taxon") : tr("Move Taxa"));
+    entry.first = first;
+    entry.count = count;
+    entry.destination = destination;
+    recordEntry(entry);
+    return true;
 }
 
-void Matrix::moveRowRightTable(int row, bool up)
+void Matrix::moveTaxaBlock(int first, int count, int destination)
 {
-    int sourceRow = row;
-    int destRow = (up ? sourceRow-1 : sourceRow+1);
+    leftTableModel->beginMoveTaxa(first, first+count-1, destination);
+    rightTableModel->beginMoveTaxa(first, first+count-1, destination);
+    moveBlock(taxonList, first, count, destination);
+    updateTaxonIndex(qMin(first, destination), qMax(first, destination) + count);
+    markTaxonListDirty();
+    leftTableModel->endMoveTaxa();
+    rightTableModel->endMoveTaxa();
 
-    // Take whole rows
-    QList<QTableWidgetItem*> sourceItems = getRowRightTable(sourceRow);
-    QList<QTableWidgetItem*> destItems = getRowRightTable(destRow);
+    // The view keeps its current index across the move, keep the selected cell in step with it
+    currentSelectedCell.first = movedPosition(currentSelectedCell.first, first, count, destination);
+    previousSelectedCell.first = movedPosition(previousSelectedCell.first, first, count, destination);
+    mw->taxonListSelect(currentSelectedCell.first);
 
-    // Set back in reverse order
-    setRowRightTable(sourceRow, destItems);
-    setRowRightTable(destRow, sourceItems);
+    isModified = true;
 }
 
-
-// Takes and returns the whole row
-QList<QTableWidgetItem*> Matrix::getRowLeftTable(int row)
+/*------------------------------------------------------------------------------------/
+ * Matrix Table Delete Row (i.e. Taxon) Functions
+ *-----------------------------------------------------------------------------------*/
+void Matrix::deleteRow(int row)
 {
-    QList<QTableWidgetItem*> rowItems;
-    for (int column = 0; column < matrixLeftTableWidget->columnCount(); ++column)
-    {
-        rowItems << matrixLeftTableWidget->takeItem(row, column);
-    }
-    return rowItems;
+    deleteRows(row, 1);
 }
 
-// Sets the whole row
-void Matrix::setRowLeftTable(int row, const QList<QTableWidgetItem*>& rowItems)
+// Delete count taxa starting at row first, their cells are kept in the journal so the delete can be undone
+bool Matrix::deleteRows(int first, int count)
 {
-    for (int column = 0; column < matrixLeftTableWidget->columnCount(); ++column)
-    {
-        matrixLeftTableWidget->setItem(row, column, rowItems.at(column));
+    if (count < 1 || first < 0 || first + count > taxaCount()) {
+        return false;
     }
-}
 
-// Takes and returns the whole row
-QList<QTableWidgetItem*> Matrix::getRowRightTable(int row)
-{
-    QList<QTableWidgetItem*> rowItems;
-    for (int column = 0; column < matrixRightTableWidget->columnCount(); ++column)
-    {
-        rowItems << matrixRightTableWidget->takeItem(row, column);
-    }
-    return rowItems;
+    MatrixJournal::Entry entry = captureTaxa(first, count, MatrixJournal::RemoveTaxa);
+    removeTaxaBlock(first, count);
+    recordEntry(entry);
+    return true;
 }
 
-// Sets the whole row
-void Matrix::setRowRightTable(int row, const QList<QTableWidgetItem*>& rowItems)
+void Matrix::removeTaxaBlock(int first, int count)
 {
-    for (int column = 0; column < matrixRightTableWidget->columnCount(); ++column)
-    {
-        matrixRightTableWidget->setItem(row, column, rowItems.at(column));
+    resetSelection();
+
+    leftTableModel->beginRemoveTaxa(first, first+count-1);
+    rightTableModel->beginRemoveTaxa(first, first+count-1);
+
+    // Release the whole rows of cells in one go
+    QSet<int> taxonIDs;
+    for (int row = first; row < first + count; row++) {
+        int taxonID = taxonIDAt(row);
+        matrixGrid.removeRow(taxonID);
+        markRowDirty(taxonID);
+        taxonPositions.remove(taxonID);
+        taxonIDs.insert(taxonID);
     }
-}
+    removeTaxaNotes(taxonIDs);
 
-/*------------------------------------------------------------------------------------/
- * Matrix Table Delete Row (i.e. Taxon) Functions
- *-----------------------------------------------------------------------------------*/
-void Matrix::deleteRow(int row)
-{
-    if (taxaCount() > 0) {
-        resetSelection();
+    taxonList.erase(taxonList.begin() + first, taxonList.begin() + first + count);
+    invalidateTaxonIndex(first);
+    markTaxonListDirty();
+    isModified = true;
 
-        int taxonID = taxonList[row].getID();
-        for(int i = 0; i < charactersCount(); i++)
-        {
-            int characterID = characterList[i].getID();
-            cellRemove(taxonID, characterID);
-        }
+    leftTableModel->endRemoveTaxa();
+    rightTableModel->endRemoveTaxa();
+
+    initializeSelection();
+}
 
-        taxonRemove(row);
+// Put back taxa and cells captured by captureTaxa()
+void Matrix::restoreTaxaBlock(MatrixJournal::Entry &entry)
+{
+    resetSelection();
 
-        deleteRowLeftTable(row);
-        deleteRowRightTable(row);
+    leftTableModel->beginInsertTaxa(entry.first, entry.first+entry.count-1);
+    rightTableModel->beginInsertTaxa(entry.first, entry.first+entry.count-1);
 
-        updateVerticalHeadersLeftTable();
-        updateVerticalHeadersRightTable();
+    insertBlock(taxonList, entry.first, entry.taxa);
+    invalidateTaxonIndex(entry.first);
+    markTaxonListDirty();
 
-        initializeSelection();
+    int columns = entry.crossIDs.count();
+    for (int t = 0; t < entry.count; t++) {
+        int taxonID = entry.taxa[t].getID();
+        markRowDirty(taxonID);
+        for (int c = 0; c < columns; c++) {
+            int index = (t * columns) + c;
+            matrixGrid.setCellData(taxonID, entry.crossIDs.at(c), MatrixJournal::cellStateSet(entry, index), MatrixJournal::cellFlags(entry, index));
+        }
     }
-}
+    for (int i = 0; i < entry.notes.count(); i++) {
+        setCellNotes(entry.notes.at(i).taxonID, entry.notes.at(i).characterID, entry.notes.at(i).oldNotes);
+    }
+    isModified = true;
 
-void Matrix::deleteRowLeftTable(int row)
-{
-    matrixLeftTableWidget->removeRow(row);
-}
+    leftTableModel->endInsertTaxa();
+    rightTableModel->endInsertTaxa();
 
-void Matrix::deleteRowRightTable(int row)
-{
-    matrixRightTableWidget->removeRow(row);
+    initializeSelection();
 }
 
 /*------------------------------------------------------------------------------------/
  * Matrix Table Insert Row (i.e. Taxon) Functions
  *-----------------------------------------------------------------------------------*/
+
+// Add the cells for a taxon already added with taxonAdd() and show it at the given row
 void Matrix::insertRow(int row)
 {
     resetSelection();
-    insertRowLeftTable(row);
-    insertRowRightTable(row);
-    updateVerticalHeadersLeftTable();
-    updateVerticalHeadersRightTable();
-    initializeSelection();
-}
-
-void Matrix::insertRowLeftTable(int row)
-{
-    QString taxonName = taxonList[row].getLabel();
-    //---- Add Row
-    matrixLeftTableWidget->insertRow(row);
-    QTableWidgetItem *newItem = new QTableWidgetItem(tr("%1").arg(taxonName));
-    newItem->setFlags(Qt::ItemIsEnabled);
-    matrixLeftTableWidget->setItem(row, 0, newItem);
-}
 
-void Matrix::insertRowRightTable(int row)
-{
-    matrixRightTableWidget->insertRow(row);
-    // Get Taxa ID
-    int taxonID = taxonList[row].getID();
-    int characterNumber = charactersCount();
+    leftTableModel->beginInsertTaxa(row, row);
+    rightTableModel->beginInsertTaxa(row, row);
 
     // Set Cell Data
-    for(int c = 0; c < characterNumber; c++)
+    int taxonID = taxonIDAt(row);
+    for(int c = 0; c < charactersCount(); c++)
     {
-        // Get Character ID
-        int characterID = characterList[c].getID();
-
-        // Create Cell data
-        cellAdd(taxonID, characterID, missingCharacter, "");
-
-        // Lookup State Data from matrixGrid
-        Cell *currentCell = matrixGrid.value(returnLocator(taxonID, characterID));
-        QString currentData = currentCell->getState();
-
-        QTableWidgetItem *newItem = new QTableWidgetItem(currentData);
-        newItem->setFlags(Qt::ItemIsEnabled|Qt::ItemIsEditable);
-        matrixRightTableWidget->setItem(row, c, newItem);
-        matrixRightTableWidget->item(row, c)->setTextAlignment(Qt::AlignHCenter|Qt::AlignVCenter);
+        cellAdd(taxonID, characterIDAt(c), missingCharacter, "");
     }
-}
 
-/*------------------------------------------------------------------------------------/
- * Matrix Table Update Vertical Headers (i.e. Tx) Functions
- *-----------------------------------------------------------------------------------*/
-void Matrix::updateVerticalHeadersLeftTable()
-{
-    int taxaNumber = taxaCount();
-    if (taxaNumber != 0) {
-        //---- Update the table view
-        for(int t = 0; t < taxaNumber; t++)
-        {
-            QTableWidgetItem *newItem = new QTableWidgetItem(tr("T%1").arg(t+1));
-            newItem->setFlags(Qt::ItemIsEnabled);
-            matrixLeftTableWidget->setVerticalHeaderItem(t,newItem);
-        }
-    }
+    leftTableModel->endInsertTaxa();
+    rightTableModel->endInsertTaxa();
 
-}
+    initializeSelection();
 
-void Matrix::updateVerticalHeadersRightTable()
-{
-    int taxaNumber = taxaCount();
-    if (taxaNumber != 0) {
-        //---- Update the table view
-        for(int t = 0; t < taxaNumber; t++)
-        {
-            QTableWidgetItem *newItem = new QTableWidgetItem(tr("T%1").arg(t+1));
-            newItem->setFlags(Qt::ItemIsEnabled);
-            matrixRightTableWidget->setVerticalHeaderItem(t,newItem);
-        }
-    }
+    recordEntry(captureTaxa(row, 1, MatrixJournal::InsertTaxa));
 }
 
 /*------------------------------------------------------------------------------------/
@@ -611,71 +559,69 @@ void Matrix::updateVerticalHeadersRightTable()
  *-----------------------------------------------------------------------------------*/
 void Matrix::moveColumn(int column, bool left)
 {
-    int sourceColumn = column;
-    int destColumn = (left ? sourceColumn-1 : sourceColumn+1);
-
-    // Take whole rows
-    QList<QTableWidgetItem*> sourceItems = getColumn(sourceColumn);
-    QList<QTableWidgetItem*> destItems = getColumn(destColumn);
-
-    // Set back in reverse order
-    setColumn(sourceColumn, destItems);
-    setColumn(destColumn, sourceItems);
+    moveCharacters(column, 1, (left ? column-1 : column+1));
 }
 
-// Takes and returns the whole row
-QList<QTableWidgetItem*> Matrix::getColumn(int column)
+// Move count characters starting at column first so that the first of them ends up at column destination
+bool Matrix::moveCharacters(int first, int count, int destination)
 {
-    QList<QTableWidgetItem*> columnItems;
-    for (int row = 0; row < matrixRightTableWidget->rowCount(); ++row)
-    {
-        columnItems << matrixRightTableWidget->takeItem(row, column);
+    if (count < 1 || first < 0 || first + count > charactersCount() || destination < 0 || destination + count > charactersCount()) {
+        return false;
     }
-    return columnItems;
+    if (destination == first) {
+        return true;
+    }
+
+    moveCharactersBlock(first, count, destination);
+
+    MatrixJournal::Entry entry;
+    entry.type = MatrixJournal::MoveCharacters;
+    entry.text = (count == 1 ? tr("Move Character") : tr("Move Characters"));
+    entry.first = first;
+    entry.count = count;
+    entry.destination = destination;
+    recordEntry(entry);
+    return true;
 }
 
-// Sets the whole row
-void Matrix::setColumn(int column, const QList<QTableWidgetItem*>& columnItems)
+void Matrix::moveCharactersBlock(int first, int count, int destination)
 {
-    for (int row = 0; row < matrixRightTableWidget->rowCount(); ++row)
-    {
-        matrixRightTableWidget->setItem(row, column, columnItems.at(row));
-    }
+    rightTableModel->beginMoveCharacters(first, first+count-1, destination);
+    moveBlock(characterList, first, count, destination);
+    updateCharacterIndex(qMin(first, destination), qMax(first, destination) + count);
+    markCharacterListDirty(false);
+    rightTableModel->endMoveCharacters();
+
+    currentSelectedCell.second = movedPosition(currentSelectedCell.second, first, count, destination);
+    previousSelectedCell.second = movedPosition(previousSelectedCell.second, first, count, destination);
+    mw->characterListSelect(currentSelectedCell.second);
+
+    isModified = true;
 }
 
 /*------------------------------------------------------------------------------------/
  * Matrix Table Insert Column (i.e. Character) Function
  *-----------------------------------------------------------------------------------*/
+
+// Add the cells for a character already added with characterAdd() and show it at the given column
 void Matrix::insertColumn(int column)
 {
     resetSelection();
 
-    // Insert Column data - set all to unknown sysmbol
-    matrixRightTableWidget->insertColumn(column);
-    // Get Taxa ID
-    int characterID = characterList[column].getID();
+    rightTableModel->beginInsertCharacters(column, column);
 
-    // Set Cell Data
+    // Insert Column data - set all to unknown sysmbol
+    int characterID = characterIDAt(column);
     for(int t = 0; t < taxaCount(); t++)
     {
-        // Get Character ID
-        int taxonID = taxonList[t].getID();
-
-        // Create Cell data
-        cellAdd(taxonID, characterID, missingCharacter, "");
-
-        // Lookup State Data from matrixGrid
-        Cell *currentCell = matrixGrid.value(returnLocator(taxonID, characterID));
-        QString currentData = currentCell->getState();
-
-        QTableWidgetItem *newItem = new QTableWidgetItem(currentData);
-        newItem->setFlags(Qt::ItemIsEnabled|Qt::ItemIsEditable);
-        matrixRightTableWidget->setItem(t, column, newItem);
-        matrixRightTableWidget->item(t, column)->setTextAlignment(Qt::AlignHCenter|Qt::AlignVCenter);
+        cellAdd(taxonIDAt(t), characterID, missingCharacter, "");
     }
 
-    updateHorizontalHeadersRightTable();
+    rightTableModel->endInsertCharacters();
+
     initializeSelection();
+
+    recordEntry(captureCharacters(column, 1, MatrixJournal::InsertCharacters));
 }
 
 /*------------------------------------------------------------------------------------/
@@ -683,42 +629,78 @@ void Matrix::insertColumn(int column)
  *-----------------------------------------------------------------------------------*/
 void Matrix::deleteColumn(int column)
 {
-    if (charactersCount() > 0) {
-        resetSelection();
+    deleteColumns(column, 1);
+}
 
-        matrixRightTableWidget->removeColumn(column);
+// Delete count characters starting at column first, their cells are kept in the journal so the delete
+// can be undone
+bool Matrix::deleteColumns(int first, int count)
+{
+    if (count < 1 || first < 0 || first + count > charactersCount()) {
+        return false;
+    }
 
-        int characterID = characterList[column].getID();
-        for(int t = 0; t < taxaCount(); t++)
-        {
-            int taxonID = taxonList[t].getID();
-            cellRemove(taxonID, characterID);
-        }
+    MatrixJournal::Entry entry = captureCharacters(first, count, MatrixJournal::RemoveCharacters);
+    removeCharactersBlock(first, count);
+    recordEntry(entry);
+    return true;
+}
 
-        charactersRemove(column);
+void Matrix::removeCharactersBlock(int first, int count)
+{
+    resetSelection();
 
-        updateHorizontalHeadersRightTable();
+    rightTableModel->beginRemoveCharacters(first, first+count-1);
 
-        initializeSelection();
+    // Release the whole columns of cells in one go
+    QSet<int> characterIDs;
+    for (int column = first; column < first + count; column++) {
+        int characterID = characterIDAt(column);
+        matrixGrid.removeColumn(characterID);
+        characterPositions.remove(characterID);
+        characterIDs.insert(characterID);
     }
+    removeCharactersNotes(characterIDs);
+
+    characterList.erase(characterList.begin() + first, characterList.begin() + first + count);
+    invalidateCharacterIndex(first);
+    markCharacterListDirty(true);
+    isModified = true;
+
+    rightTableModel->endRemoveCharacters();
+
+    initializeSelection();
 }
 
-/*------------------------------------------------------------------------------------/
- * Matrix Right Table Update Horizontal Headers (i.e. Cx) Function
- *-----------------------------------------------------------------------------------*/
-void Matrix::updateHorizontalHeadersRightTable()
-{
-    int characterNumber = charactersCount();
-    if (characterNumber != 0) {
-        //---- Update the table view
-        for(int c = 0; c < characterNumber; c++)
-        {
-            QTableWidgetItem *newItem = new QTableWidgetItem(tr("C%1").arg(c+1));
-            newItem->setFlags(Qt::ItemIsEnabled);
-            matrixRightTableWidget->setHorizontalHeaderItem(c,newItem);
+// Put back characters and cells captured by captureCharacters()
+void Matrix::restoreCharactersBlock(MatrixJournal::Entry &entry)
+{
+    resetSelection();
+
+    rightTableModel->beginInsertCharacters(entry.first, entry.first+entry.count-1);
+
+    insertBlock(characterList, entry.first, entry.characters);
+    invalidateCharacterIndex(entry.first);
+    markCharacterListDirty(true);
+
+    int rows = entry.crossIDs.count();
+    for (int c = 0; c < entry.count; c++) {
+        int characterID = entry.characters[c].getID();
+        for (int t = 0; t < rows; t++) {
+            int index = (c * rows) + t;
+            matrixGrid.setCellData(entry.crossIDs.at(t), characterID, MatrixJournal::cellStateSet(entry, index), MatrixJournal::cellFlags(entry, index));
         }
     }
+    for (int i = 0; i < entry.notes.count(); i++) {
+        setCellNotes(entry.notes.at(i).taxonID, entry.notes.at(i).characterID, entry.notes.at(i).oldNotes);
+    }
+    isModified = true;
+
+    rightTableModel->endInsertCharacters();
+
+    initializeSelection();
 }
+
 /*------------------------------------------------------------------------------------/
  * Filename Functions
  *-----------------------------------------------------------------------------------*/
@@ -749,6 +731,7 @@ void Matrix::setMatrixDescription(QString description)
 {
     isModified = true;
     matrixDescription = description;
+    autosaveDetails();
 };
 
 QString Matrix::getMatrixDescription()
@@ -761,6 +744,9 @@ void Matrix::setMissingCharacter(QString character)
 {
     isModified = true;
     missingCharacter = character;
+    matrixGrid.setMissingSymbol(character);
+    cellDelegate->clearGlyphCache();
+    autosaveDetails();
 };
 
 QString Matrix::getMissingCharacter()
@@ -773,6 +759,7 @@ void Matrix::setMatrixType(int type)
 {
     isModified = true;
     matrixType = type;
+    autosaveDetails();
 };
 
 int Matrix::getMatrixType()
@@ -790,6 +777,9 @@ void Matrix::setGapCharacter(QString character)
 {
     isModified = true;
     gapCharacter = character;
+    matrixGrid.setGapSymbol(character);
+    cellDelegate->clearGlyphCache();
+    autosaveDetails();
 };
 
 QString Matrix::getGapCharacter()
@@ -802,6 +792,7 @@ void Matrix::setMatrixName(QString name)
 {
     isModified = true;
     matrixName = name;
+    autosaveDetails();
 };
 
 QString Matrix::getMatrixName()
@@ -819,6 +810,8 @@ void Matrix::closeEvent(QCloseEvent *event)
 {
     if (maybeSaveCheck()) {
         mw->logAppend("Matrix","closing window containing matrix file \""+currentFile+"\".");
+        stopAutosave();
+        releaseCells();
         mw->logAppend("Matrix (Mdi Child)","destroyed.");        
         event->accept();
     } else {
@@ -863,7 +856,7 @@ void Matrix::newFile()
     setWindowTitle(currentFile + "[*]");
     mw->logAppend("Matrix","new matrix file called \""+currentFile+"\" has been created.");
 
-    totalNumberToProcess = ((numTaxaToAdd+numTaxaToAdd+numCharatersToAdd)*2);
+    totalNumberToProcess = (numTaxaToAdd+numTaxaToAdd+numCharatersToAdd);
     totalNumberProcessed = 0;
     progress = new QProgressDialog("Setting up the Matrix...", "Abort", 0, totalNumberToProcess, mw);
     progress->setCancelButton(0);
@@ -875,6 +868,8 @@ void Matrix::newFile()
         progress->show();
     }
 
+    beginSetupMatrixTable();
+
     // Taxa
     for (int n=1; n<(numTaxaToAdd+1); n++) {
         taxonAdd(QString("Taxon %1").arg(n), "");
@@ -891,9 +886,11 @@ void Matrix::newFile()
     }
 
     // Data Cells
+    matrixGrid.reserve(numTaxaToAdd, numCharatersToAdd);
     for (int t=0; t<(numTaxaToAdd); t++) {
+        int taxonID = taxonIDAt(t);
         for (int c=0; c<(numCharatersToAdd); c++) {
-            cellAdd(t, c, missingCharacter, "");
+            cellAdd(taxonID, characterIDAt(c), missingCharacter, "");
         }
         totalNumberProcessed++;
         progress->setValue(totalNumberProcessed);
@@ -901,19 +898,214 @@ void Matrix::newFile()
 
     setupMatrixTable();
 
+    delete progress;
+    progress = 0;
+
+    // Setting up the matrix is not an undoable edit
+    int undoMemoryLimit = settings->getSetting("undoMemoryLimit").toInt();
+    if (undoMemoryLimit > 0) {
+        journal.setMemoryLimit((qint64)undoMemoryLimit * 1024 * 1024);
+    }
+    journal.clear();
+
+    // The snapshot is taken now, while the user is waiting anyway, rather than on the first edit
+    startAutosave();
+
     mw->logAppend("Matrix",
                   QString("\""+currentFile+"\" has %1 'Taxa' and %2 'Characters'. States set to unknown ("+missingCharacter+") symbol.")
                   .arg(taxaCount())
                   .arg(charactersCount()));
 }
 
+//---- Import NEXUS
+// Take over the taxa, characters, equates and cells parsed from a NEXUS file. They are swapped out of the blocks
+// rather than copied, so this costs the same for 10^2 or 10^8 cells, and the tables only see the final counts.
+void Matrix::importNexus(QString name, NexusParserCharactersBlock *charactersBlock)
+{
+    isUntitled = true;
+    isModified = true;
+
+    currentFile = name + ".made";
+    setWindowTitle(currentFile + "[*]");
+    matrixName = name;
+
+    // 1 = standard, 2 = dna, ... in the reader, continuous data is kept as STANDARD
+    int datatype = charactersBlock->getDatatype();
+    if (datatype >= NexusParserCharactersBlock::dna && datatype <= NexusParserCharactersBlock::protein) {
+        matrixType = datatype - 1;
+    } else {
+        matrixType = 0;
+    }
+
+    beginSetupMatrixTable();
+
+    charactersBlock->getTaxaBlock()->takeTaxa(taxonList);
+    charactersBlock->takeCharacters(characterList);
+    charactersBlock->takeEquates(equateList);
+    charactersBlock->takeCells(matrixGrid, cellNotesTable);
+
+    missingCharacter = QString(charactersBlock->getMissingSymbol());
+    gapCharacter = QString(charactersBlock->getGapSymbol());
+    matrixGrid.setMissingSymbol(missingCharacter);
+    matrixGrid.setGapSymbol(gapCharacter);
+
+    finishLoading();
+    setupMatrixTable();
+
+    setWindowModified(true);
+    startAutosave();
+
+    mw->logAppend("Matrix",
+                  QString("\""+currentFile+"\" has been imported with %1 'Taxa', %2 'Characters' and %3 KB of cell data.")
+                  .arg(taxaCount())
+                  .arg(charactersCount())
+                  .arg(memoryUsage()/1024));
+}
+
+// Common end of importing and loading: carry on the IDs, rebuild the position indexes, fill any missing rows
+// and start with an empty undo history
+void Matrix::finishLoading()
+{
+    // New IDs carry on after the loaded ones
+    nextTaxonID = 0;
+    for (int i = 0; i < taxonList.count(); i++) {
+        nextTaxonID = qMax(nextTaxonID, taxonList[i].getID() + 1);
+    }
+    nextCharacterID = 0;
+    for (int i = 0; i < characterList.count(); i++) {
+        nextCharacterID = qMax(nextCharacterID, characterList[i].getID() + 1);
+    }
+    nextEquateID = 0;
+    for (int i = 0; i < equateList.count(); i++) {
+        nextEquateID = qMax(nextEquateID, equateList[i].getID() + 1);
+    }
+
+    taxonPositions.clear();
+    characterPositions.clear();
+    invalidateTaxonIndex(0);
+    invalidateCharacterIndex(0);
+
+    // Taxa that were left out of the MATRIX command have no cells, they start out as missing
+    if (!characterList.isEmpty()) {
+        for (int t = 0; t < taxonList.count(); t++) {
+            int taxonID = taxonList[t].getID();
+            if (matrixGrid.hasCell(taxonID, characterList[0].getID())) {
+                continue;
+            }
+            for (int c = 0; c < characterList.count(); c++) {
+                matrixGrid.setCellData(taxonID, characterList[c].getID(), 0, MatrixGrid::MissingFlag);
+            }
+        }
+    }
+
+    // Loading is not an undoable edit
+    int undoMemoryLimit = settings->getSetting("undoMemoryLimit").toInt();
+    if (undoMemoryLimit > 0) {
+        journal.setMemoryLimit((qint64)undoMemoryLimit * 1024 * 1024);
+    }
+    journal.clear();
+}
+
 //---- Load File
 bool Matrix::loadFile(QString fileName)
 {
-    // Load file as sqlLite DB
+    QElapsedTimer timer;
+    timer.start();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    beginSetupMatrixTable();
+
+    Database database;
+    bool isLoaded = (database.open(fileName) && database.loadMatrix(this));
+    QString errorText = database.lastError();
+    database.close();
+
+    if (isLoaded) {
+        finishLoading();
+        resetDirtyRegions(database.getStorageMode() == Database::RowStorage);
+    }
+    setupMatrixTable();
+    QApplication::restoreOverrideCursor();
+
+    if (!isLoaded) {
+        mw->logAppend("Matrix", QString("\""+fileName+"\" could not be opened: %1").arg(errorText));
+        QMessageBox::warning(this, tr("MaDE"), tr("Cannot read file %1:\n%2.").arg(fileName).arg(errorText));
+        return false;
+    }
 
     setCurrentFile(fileName);
+    setWindowModified(false);
+    startAutosave();
+
+    mw->logAppend("Matrix",
+                  QString("\""+currentFile+"\" has been opened with %1 'Taxa' and %2 'Characters' in %3 ms.")
+                  .arg(taxaCount())
+                  .arg(charactersCount())
+                  .arg(timer.elapsed()));
+    return true;
+}
+
+//---- Recover File
+// Open the base file of a journal left behind by a crashed session and replay the journal over it. The matrix
+// carries on with the same journal, so the recovered changes are kept until it is saved.
+bool Matrix::recoverFile(QString journalFile)
+{
+    AutosaveJournal::Header header;
+    QList<AutosaveJournal::Record> records;
+    if (!AutosaveJournal::read(journalFile, header, records)) {
+        mw->logAppend("Autosave", "\""+journalFile+"\" is not a MaDE journal.");
+        return false;
+    }
+    if (!header.isSnapshot && QFileInfo(header.baseFile).lastModified() != header.baseModified) {
+        mw->logAppend("Autosave", "\""+header.baseFile+"\" has changed since its journal was started, the journal cannot be replayed.");
+        QMessageBox::warning(this, tr("MaDE"), tr("%1 has been changed since the unsaved changes were made, they cannot be recovered.").arg(header.baseFile));
+        return false;
+    }
+
+    isReplaying = true;
+    if (!loadFile(header.baseFile)) {
+        isReplaying = false;
+        return false;
+    }
+
+    // The views are reset once at the end, whatever the records did to the taxa and characters
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QVector<int> symbolBits;
+    beginBatchUpdate();
+    for (int i = 0; i < records.count(); i++) {
+        replayRecord(records[i], symbolBits);
+    }
+    endBatchUpdate();
+    beginSetupMatrixTable();
+    finishLoading();
+    setupMatrixTable();
+    QApplication::restoreOverrideCursor();
+    isReplaying = false;
+
+    if (header.isSnapshot) {
+        isUntitled = true;
+        currentFile = header.title;
+        setWindowTitle(currentFile + "[*]");
+        resetDirtyRegions(false);
+    }
+    isModified = true;
+    setWindowModified(true);
+
+    // Keep appending to the journal that was replayed, starting with this grid's symbols
+    autosaveJournal = new AutosaveJournal(mw, this);
+    if (autosaveJournal->resume(journalFile)) {
+        QString symbols = matrixGrid.getSymbols();
+        autosaveJournal->append(AutosaveJournal::SymbolsRecord, symbols.toUtf8());
+        journaledSymbols = symbols.size();
+    } else {
+        delete autosaveJournal;
+        autosaveJournal = 0;
+        startAutosave();
+    }
 
+    mw->logAppend("Matrix",
+                  QString("\""+currentFile+"\" has been recovered with %1 journaled changes.")
+                  .arg(records.count()));
     return true;
 }
 
@@ -938,12 +1130,103 @@ bool Matrix::saveFileAs()
 }
 
 //---- Save File
+// Saving back to the file the matrix came from only writes what has changed since, in one transaction. Otherwise
+// the matrix is written to a new database next to the file and only replaces it once the save has committed, so a
+// failed save never leaves a half written file behind.
 bool Matrix::saveFile(QString fileName)
 {
-    // Save file as SQLite DB
+    QElapsedTimer timer;
+    timer.start();
+
+    bool isRowStorage = (settings->getSetting("fileStorage").toInt() != 0);
+    if (canSaveChanges && isRowStorage && !isUntitled && QFileInfo(fileName).canonicalFilePath() == currentFile) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        Database database;
+        bool isSaved = (database.open(currentFile) && database.saveChanges(this));
+        QString errorText = database.lastError();
+        database.close();
+        QApplication::restoreOverrideCursor();
+
+        if (isSaved) {
+            mw->logAppend("Matrix",
+                          QString("\""+currentFile+"\" has been saved with %1 changed rows in %2 ms.")
+                          .arg(hasAllRowsDirty ? taxaCount() : dirtyTaxonRows.count())
+                          .arg(timer.elapsed()));
+            resetDirtyRegions(true);
+            setCurrentFile(currentFile);
+            setWindowModified(false);
+            stopAutosave();
+            startAutosave();
+            return true;
+        }
+
+        // Fall back to writing the whole file
+        mw->logAppend("Matrix", QString("changes to \""+currentFile+"\" could not be saved (%1), saving the whole matrix.").arg(errorText));
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    QString savingName = fileName + ".saving";
+    QFile::remove(savingName);
+    QFile::remove(savingName + "-wal");
+    QFile::remove(savingName + "-shm");
+
+    Database database;
+    if (!isRowStorage) {
+        database.setStorageMode(Database::CellStorage);
+    }
+    bool isSaved = (database.open(savingName) && database.saveMatrix(this));
+    QString errorText = database.lastError();
+    database.close();
+
+    // Never left with neither file: the old one is moved aside, only removed once the new one has its name and put
+    // back if it cannot be. If even that fails both are kept for the user.
+    bool isOldFileSafe = true;
+    if (isSaved) {
+        QString backupName = fileName + ".backup";
+        bool hasOldFile = QFile::exists(fileName);
+        if (hasOldFile) {
+            QFile::remove(backupName);
+            isSaved = QFile::rename(fileName, backupName);
+        }
+        if (isSaved) {
+            isSaved = QFile::rename(savingName, fileName);
+            if (isSaved) {
+                QFile::remove(backupName);
+            } else if (hasOldFile && !QFile::rename(backupName, fileName)) {
+                isOldFileSafe = false;
+            }
+        }
+        if (!isOldFileSafe) {
+            errorText = tr("the new file could not replace the old one, they are in %1 and %2")
+                    .arg(savingName).arg(backupName);
+        } else if (!isSaved) {
+            errorText = tr("the new file could not replace the old one");
+        }
+    }
+    if (!isSaved && isOldFileSafe) {
+        QFile::remove(savingName);
+    }
+    QApplication::restoreOverrideCursor();
+
+    if (!isSaved) {
+        mw->logAppend("Matrix", QString("\""+fileName+"\" could not be saved: %1").arg(errorText));
+        QMessageBox::warning(this, tr("MaDE"), tr("Cannot write file %1:\n%2.").arg(fileName).arg(errorText));
+        return false;
+    }
 
+    resetDirtyRegions(isRowStorage);
     setCurrentFile(fileName);
+    setWindowModified(false);
+    stopAutosave();
+    startAutosave();
 
+    mw->logAppend("Matrix",
+                  QString("\""+currentFile+"\" has been saved with %1 'Taxa', %2 'Characters' and %3 cells in %4 ms.")
+                  .arg(taxaCount())
+                  .arg(charactersCount())
+                  .arg(cellCount())
+                  .arg(timer.elapsed()));
     return true;
 }
 
@@ -963,23 +1246,49 @@ void Matrix::settingsDialog()
 
 //---- Add Taxon
 bool Matrix::taxonAdd(QString name, QString notes) {   
+    taxonPositions.insert(nextTaxonID, taxonList.count());
     taxonList.append(Taxon(nextTaxonID++, name, notes));
+    markTaxonListDirty();
     isModified = true;
     return true;
 }
 
 //---- Edit Taxon
-bool Matrix::taxonEdit(int key, QString name, QString notes) {
+bool Matrix::taxonEdit(int key, QString name, QString notes, bool isEnabled) {
+    MatrixJournal::Entry entry;
+    entry.type = MatrixJournal::TaxonEdit;
+    entry.text = tr("Edit Taxon");
+    entry.id = taxonList[key].getID();
+    entry.oldLabel = taxonList[key].getLabel();
+    entry.oldNotes = taxonList[key].getNotes();
+    entry.oldIsEnabled = taxonList[key].getIsEnabled();
+    entry.newLabel = name;
+    entry.newNotes = notes;
+    entry.newIsEnabled = isEnabled;
+    entry.oldIsOrdered = entry.newIsOrdered = false;
+    if (entry.newLabel == entry.oldLabel && entry.newNotes == entry.oldNotes && entry.newIsEnabled == entry.oldIsEnabled) {
+        return true;
+    }
+
     taxonList[key].setLabel(name);
     taxonList[key].setNotes(notes);
-    isModified = true;
+    taxonList[key].setIsEnabled(isEnabled);
+    markTaxonDirty(entry.id);
+    leftTableModel->taxonChanged(key);
+    hasBatchItemChanged = true;
+
+    recordEntry(entry);
     return true;
 }
 
 //---- Remove Taxon
 bool Matrix::taxonRemove(int row)
 {
+    markRowDirty(taxonIDAt(row));
+    taxonPositions.remove(taxonIDAt(row));
     taxonList.removeAt(row);
+    invalidateTaxonIndex(row);
+    markTaxonListDirty();
     isModified = true;
     return true;
 }
@@ -1040,16 +1349,40 @@ bool Matrix::characterAdd(QString name, QString notes) {
         break;
     }
 
+    characterPositions.insert(character.getID(), characterList.count());
     characterList.append(character);
+    markCharacterListDirty(true);
     isModified = true;
     return true;
 }
 
 //---- Edit Character
-bool Matrix::characterEdit(int key, QString name, QString notes) {
+bool Matrix::characterEdit(int key, QString name, QString notes, bool isEnabled, bool isOrdered) {
+    MatrixJournal::Entry entry;
+    entry.type = MatrixJournal::CharacterEdit;
+    entry.text = tr("Edit Character");
+    entry.id = characterList[key].getID();
+    entry.oldLabel = characterList[key].getLabel();
+    entry.oldNotes = characterList[key].getNotes();
+    entry.oldIsEnabled = characterList[key].getIsEnabled();
+    entry.oldIsOrdered = characterList[key].getIsOrdered();
+    entry.newLabel = name;
+    entry.newNotes = notes;
+    entry.newIsEnabled = isEnabled;
+    entry.newIsOrdered = isOrdered;
+    if (entry.newLabel == entry.oldLabel && entry.newNotes == entry.oldNotes
+            && entry.newIsEnabled == entry.oldIsEnabled && entry.newIsOrdered == entry.oldIsOrdered) {
+        return true;
+    }
+
     characterList[key].setLabel(name);
     characterList[key].setNotes(notes);
-    isModified = true;
+    characterList[key].setIsEnabled(isEnabled);
+    characterList[key].setIsOrdered(isOrdered);
+    markCharacterDirty(entry.id);
+    hasBatchItemChanged = true;
+
+    recordEntry(entry);
     return true;
 }
 
@@ -1061,7 +1394,10 @@ int Matrix::charactersCount()
 //---- Remove Taxon
 bool Matrix::charactersRemove(int column)
 {
+    characterPositions.remove(characterIDAt(column));
     characterList.removeAt(column);
+    invalidateCharacterIndex(column);
+    markCharacterListDirty(true);
     isModified = true;
     return true;
 }
@@ -1074,6 +1410,10 @@ void Matrix::charactersDialog(int column = 0)
     dialog->settings = settings;
     dialog->initalize(column);
     dialog->exec();
+
+    // The dialog edits the character states directly, everything else goes through characterEdit()
+    markCharacterListDirty(false);
+    autosaveCharacters();
 }
 
 /*------------------------------------------------------------------------------------/
@@ -1100,9 +1440,11 @@ State Matrix::getState(int characterKey, int stateKey)
 //---- Add Data Cell
 bool Matrix::cellAdd(int taxonID, int characterID, QString state, QString notes)
 {
-    Cell *cellData = new Cell(state, notes);
-
-    matrixGrid.insert(returnLocator(taxonID, characterID), cellData);
+    if (!matrixGrid.setCell(taxonID, characterID, state)) {
+        return false;
+    }
+    markRowDirty(taxonID);
+    setCellNotes(taxonID, characterID, notes);
 
     isModified = true;
     return true;
@@ -1111,18 +1453,57 @@ bool Matrix::cellAdd(int taxonID, int characterID, QString state, QString notes)
 //---- Edit Data Cell
 bool Matrix::cellEdit(int taxonID, int characterID, QString state, QString notes)
 {
-    Cell *cellData = new Cell(state, notes);
+    MatrixJournal::CellDelta delta;
+    delta.taxonID = taxonID;
+    delta.characterID = characterID;
+    delta.oldStateSet = matrixGrid.getStateSet(taxonID, characterID);
+    delta.oldFlags = matrixGrid.getFlags(taxonID, characterID);
+    QString oldNotes = cellNotes(taxonID, characterID);
 
-    matrixGrid.insert(returnLocator(taxonID, characterID), cellData);
-
-    isModified = true;
+    // Cells are edited in place in the grid
+    if (!matrixGrid.setCell(taxonID, characterID, state)) {
+        return false;
+    }
+    markRowDirty(taxonID);
+    setCellNotes(taxonID, characterID, notes);
+    rightTableModel->cellChanged(taxonPosition(taxonID), characterPosition(characterID));
+
+    delta.newStateSet = matrixGrid.getStateSet(taxonID, characterID);
+    delta.newFlags = matrixGrid.getFlags(taxonID, characterID);
+
+    // Record only what actually changed
+    MatrixJournal::Entry entry;
+    entry.type = MatrixJournal::CellEdit;
+    entry.text = tr("Edit Cell");
+    if (delta.newStateSet != delta.oldStateSet || delta.newFlags != delta.oldFlags) {
+        entry.cells.append(delta);
+    }
+    if (notes != oldNotes) {
+        MatrixJournal::NoteDelta note;
+        note.taxonID = taxonID;
+        note.characterID = characterID;
+        note.oldNotes = oldNotes;
+        note.newNotes = notes;
+        entry.notes.append(note);
+        if (entry.cells.isEmpty()) {
+            entry.text = tr("Edit Cell Notes");
+        }
+    }
+    if (!entry.cells.isEmpty() || !entry.notes.isEmpty()) {
+        recordEntry(entry);
+    }
+
+    isModified = true;
     return true;
 }
 
 //---- Remove Data Cell
 bool Matrix::cellRemove(int taxonID, int characterID)
 {
-    matrixGrid.remove(returnLocator(taxonID, characterID));
+    matrixGrid.clearCell(taxonID, characterID);
+    cellNotesTable.remove(returnLocator(taxonID, characterID));
+    markRowDirty(taxonID);
+    markNotesDirty(taxonID, characterID);
 
     isModified = true;
     return true;
@@ -1130,7 +1511,778 @@ bool Matrix::cellRemove(int taxonID, int characterID)
 
 int Matrix::cellCount()
 {
-    return matrixGrid.count();
+    return matrixGrid.cellCount();
+}
+
+// Return the state text of a cell, e.g. "0", "(01)" or "{AG}"
+QString Matrix::cellState(int taxonID, int characterID)
+{
+    return matrixGrid.getState(taxonID, characterID);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Matrix Cell Notes Functions
+ *-----------------------------------------------------------------------------------*/
+
+bool Matrix::hasCellNotes(int taxonID, int characterID)
+{
+    return cellNotesTable.contains(returnLocator(taxonID, characterID));
+}
+
+// Return the notes of a cell, empty if it has none
+QString Matrix::cellNotes(int taxonID, int characterID)
+{
+    return cellNotesTable.value(returnLocator(taxonID, characterID));
+}
+
+// Set the notes of a cell, setting empty notes removes the entry
+void Matrix::setCellNotes(int taxonID, int characterID, QString notes)
+{
+    if (notes.isEmpty()) {
+        cellNotesTable.remove(returnLocator(taxonID, characterID));
+    } else {
+        cellNotesTable.insert(returnLocator(taxonID, characterID), notes);
+    }
+    markNotesDirty(taxonID, characterID);
+}
+
+// Approximate bytes held by the cell data, i.e. the grid and the notes table
+qint64 Matrix::memoryUsage()
+{
+    qint64 bytes = matrixGrid.memoryUsage();
+    QHashIterator<QPair<int,int>, QString> i(cellNotesTable);
+    while (i.hasNext()) {
+        i.next();
+        bytes += (qint64)(sizeof(QPair<int,int>) + sizeof(QString) + sizeof(void *)) + (i.value().capacity() * sizeof(QChar));
+    }
+    return bytes;
+}
+
+// Free all cell data in one go, used when the matrix is closed
+void Matrix::releaseCells()
+{
+    mw->logAppend("Matrix",QString("released %1 KB of cell data.").arg(memoryUsage()/1024));
+    matrixGrid.clear();
+    cellNotesTable.clear();
+    journal.clear();
+}
+
+// Remove the notes of a set of taxa in a single pass over the notes table
+void Matrix::removeTaxaNotes(QSet<int> taxonIDs)
+{
+    QMutableHashIterator<QPair<int,int>, QString> i(cellNotesTable);
+    while (i.hasNext()) {
+        i.next();
+        if (taxonIDs.contains(i.key().first)) {
+            markNotesDirty(i.key().first, i.key().second);
+            i.remove();
+        }
+    }
+}
+
+void Matrix::removeCharactersNotes(QSet<int> characterIDs)
+{
+    QMutableHashIterator<QPair<int,int>, QString> i(cellNotesTable);
+    while (i.hasNext()) {
+        i.next();
+        if (characterIDs.contains(i.key().second)) {
+            markNotesDirty(i.key().first, i.key().second);
+            i.remove();
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------/
+ * Matrix Dirty Region Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Nothing is tracked until the matrix has a file that the changes can be written into
+void Matrix::markRowDirty(int taxonID)
+{
+    if (canSaveChanges) {
+        dirtyTaxonRows.insert(taxonID);
+    }
+}
+
+void Matrix::markNotesDirty(int taxonID, int characterID)
+{
+    if (canSaveChanges) {
+        dirtyNotes.insert(qMakePair(taxonID, characterID));
+    }
+}
+
+void Matrix::markTaxonDirty(int taxonID)
+{
+    if (canSaveChanges) {
+        dirtyTaxa.insert(taxonID);
+    }
+}
+
+void Matrix::markCharacterDirty(int characterID)
+{
+    if (canSaveChanges) {
+        dirtyCharacters.insert(characterID);
+    }
+}
+
+// Taxa added, removed or moved, the positions of the others change with them
+void Matrix::markTaxonListDirty()
+{
+    isTaxonListDirty = true;
+}
+
+// Characters moved or edited in place, or, with isRowsChanged, added or removed
+void Matrix::markCharacterListDirty(bool isRowsChanged)
+{
+    isCharacterListDirty = true;
+    if (isRowsChanged) {
+        hasAllRowsDirty = true;
+    }
+}
+
+// Called once the matrix matches its file, canSave is false when the next save has to write the whole file
+void Matrix::resetDirtyRegions(bool canSave)
+{
+    canSaveChanges = canSave;
+    isTaxonListDirty = false;
+    isCharacterListDirty = false;
+    hasAllRowsDirty = false;
+    dirtyTaxonRows.clear();
+    dirtyTaxa.clear();
+    dirtyCharacters.clear();
+    dirtyNotes.clear();
+}
+
+/*------------------------------------------------------------------------------------/
+ * Matrix Autosave Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Start a journal for the matrix as it is now. An untitled matrix is first saved as the journal's snapshot, so this
+// is only called when a matrix is created, imported, opened or saved, never from an edit.
+bool Matrix::startAutosave()
+{
+    if (isReplaying || isAutosaveOff || autosaveJournal) {
+        return false;
+    }
+
+    autosaveJournal = new AutosaveJournal(mw, this);
+    AutosaveJournal::Header header;
+    header.isSnapshot = isUntitled;
+    header.title = currentFile;
+    header.created = QDateTime::currentDateTime();
+    if (isUntitled) {
+        header.baseFile = autosaveJournal->getSnapshotFileName();
+        Database database;
+        bool isSaved = (database.open(header.baseFile) && database.saveMatrix(this));
+        database.close();
+        if (!isSaved) {
+            mw->logAppend("Autosave", QString("could not save a snapshot of \""+currentFile+"\", autosave is off for this matrix: %1").arg(database.lastError()));
+            AutosaveJournal::remove(autosaveJournal->getFileName());
+            delete autosaveJournal;
+            autosaveJournal = 0;
+            isAutosaveOff = true;
+            return false;
+        }
+    } else {
+        header.baseFile = currentFile;
+        header.baseModified = QFileInfo(currentFile).lastModified();
+    }
+
+    if (!autosaveJournal->create(header)) {
+        mw->logAppend("Autosave", QString("could not create \""+autosaveJournal->getFileName()+"\", autosave is off for this matrix."));
+        autosaveJournal->discard();
+        delete autosaveJournal;
+        autosaveJournal = 0;
+        isAutosaveOff = true;
+        return false;
+    }
+
+    QString symbols = matrixGrid.getSymbols();
+    autosaveJournal->append(AutosaveJournal::SymbolsRecord, symbols.toUtf8());
+    journaledSymbols = symbols.size();
+    return true;
+}
+
+// Close and remove the journal, the matrix has been saved or is being closed
+void Matrix::stopAutosave()
+{
+    if (autosaveJournal) {
+        autosaveJournal->discard();
+        delete autosaveJournal;
+        autosaveJournal = 0;
+    }
+}
+
+// Record a change that has just been made, only ever an append. There is no journal if autosave is off.
+void Matrix::autosave(AutosaveJournal::RecordType type, QByteArray payload)
+{
+    if (isReplaying || !autosaveJournal) {
+        return;
+    }
+    autosaveJournal->append(type, payload);
+}
+
+void Matrix::autosaveEntry(MatrixJournal::Entry &entry, bool isUndo)
+{
+    if (isReplaying || isAutosaveOff) {
+        return;
+    }
+
+    // State sets are bits of the grid's symbols, the journal needs any symbols added since it last heard
+    if (autosaveJournal && matrixGrid.getSymbols().size() != journaledSymbols) {
+        QString symbols = matrixGrid.getSymbols();
+        autosaveJournal->append(AutosaveJournal::SymbolsRecord, symbols.toUtf8());
+        journaledSymbols = symbols.size();
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    MatrixJournal::writeEntry(out, entry);
+    autosave(isUndo ? AutosaveJournal::UndoRecord : AutosaveJournal::ApplyRecord, payload);
+}
+
+void Matrix::autosaveDetails()
+{
+    if (isReplaying || isAutosaveOff) {
+        return;
+    }
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << matrixName << matrixDescription << (qint32)matrixType << missingCharacter << gapCharacter;
+    autosave(AutosaveJournal::DetailsRecord, payload);
+}
+
+void Matrix::autosaveCharacters()
+{
+    if (isReplaying || isAutosaveOff) {
+        return;
+    }
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    MatrixJournal::writeCharacters(out, characterList);
+    autosave(AutosaveJournal::CharactersRecord, payload);
+}
+
+// Apply one journal record. symbolBits maps bit n of a journaled state set to this grid's bit.
+void Matrix::replayRecord(AutosaveJournal::Record &record, QVector<int> &symbolBits)
+{
+    QDataStream in(record.payload);
+
+    switch (record.type) {
+    case AutosaveJournal::SymbolsRecord: {
+        QString symbols = QString::fromUtf8(record.payload);
+        symbolBits.resize(symbols.size());
+        for (int i = 0; i < symbols.size(); i++) {
+            quint64 stateSet;
+            int flags;
+            matrixGrid.encodeState(QString(symbols.at(i)), stateSet, flags);
+            symbolBits[i] = matrixGrid.symbolIndex(symbols.at(i));
+        }
+        break;
+    }
+    case AutosaveJournal::ApplyRecord:
+    case AutosaveJournal::UndoRecord: {
+        MatrixJournal::Entry entry = MatrixJournal::readEntry(in);
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+
+        bool isSameOrder = true;
+        for (int i = 0; i < symbolBits.count(); i++) {
+            isSameOrder = isSameOrder && (symbolBits.at(i) == i);
+        }
+        if (!isSameOrder) {
+            MatrixJournal::remapStateSets(entry, symbolBits);
+        }
+        applyEntry(entry, record.type == AutosaveJournal::UndoRecord);
+        break;
+    }
+    case AutosaveJournal::DetailsRecord: {
+        qint32 type;
+        in >> matrixName >> matrixDescription >> type >> missingCharacter >> gapCharacter;
+        matrixType = type;
+        matrixGrid.setMissingSymbol(missingCharacter);
+        matrixGrid.setGapSymbol(gapCharacter);
+        break;
+    }
+    case AutosaveJournal::CharactersRecord: {
+        QList<Character> characters = MatrixJournal::readCharacters(in);
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+        QSet<int> removedIDs;
+        for (int i = 0; i < characterList.count(); i++) {
+            removedIDs.insert(characterList[i].getID());
+        }
+        bool isRowsChanged = (characters.count() != characterList.count());
+        for (int i = 0; i < characters.count(); i++) {
+            isRowsChanged = isRowsChanged || !removedIDs.contains(characters[i].getID());
+            removedIDs.remove(characters[i].getID());
+        }
+        foreach (int characterID, removedIDs) {
+            matrixGrid.removeColumn(characterID);
+        }
+        removeCharactersNotes(removedIDs);
+
+        characterList = characters;
+        characterPositions.clear();
+        invalidateCharacterIndex(0);
+        markCharacterListDirty(isRowsChanged);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/*------------------------------------------------------------------------------------/
+ * Matrix Undo/Redo Functions
+ *-----------------------------------------------------------------------------------*/
+
+void Matrix::undo()
+{
+    if (!journal.canUndo() || batchDepth > 0) {
+        return;
+    }
+
+    // A batch is undone as a whole, newest entry first
+    QString text = journal.undoText();
+    int group = journal.undoEntry().group;
+    beginBatchUpdate();
+    do {
+        applyEntry(journal.undoEntry(), true);
+        autosaveEntry(journal.undoEntry(), true);
+        journal.stepBack();
+    } while (group != 0 && journal.canUndo() && journal.undoEntry().group == group);
+    endBatchUpdate();
+
+    mw->logAppend("Matrix Edit",QString("undo '%1'.").arg(text));
+}
+
+void Matrix::redo()
+{
+    if (!journal.canRedo() || batchDepth > 0) {
+        return;
+    }
+
+    QString text = journal.redoText();
+    int group = journal.redoEntry().group;
+    beginBatchUpdate();
+    do {
+        applyEntry(journal.redoEntry(), false);
+        autosaveEntry(journal.redoEntry(), false);
+        journal.stepForward();
+    } while (group != 0 && journal.canRedo() && journal.redoEntry().group == group);
+    endBatchUpdate();
+
+    mw->logAppend("Matrix Edit",QString("redo '%1'.").arg(text));
+}
+
+bool Matrix::canUndo()
+{
+    return journal.canUndo();
+}
+
+bool Matrix::canRedo()
+{
+    return journal.canRedo();
+}
+
+QString Matrix::undoText()
+{
+    return journal.undoText();
+}
+
+QString Matrix::redoText()
+{
+    return journal.redoText();
+}
+
+void Matrix::setUndoMemoryLimit(qint64 bytes)
+{
+    journal.setMemoryLimit(bytes);
+    mw->updateEditMenu();
+}
+
+void Matrix::recordEntry(MatrixJournal::Entry entry)
+{
+    autosaveEntry(entry, false);
+    journal.record(entry);
+    warnIfDropped();
+    isModified = true;
+    if (!isBatchUpdate) {
+        setWindowModified(isModified);
+        mw->updateEditMenu();
+    }
+}
+
+// An edit too big for the undo memory limit has been made, and it has cleared the history before it
+void Matrix::warnIfDropped()
+{
+    QString text = journal.takeDroppedText();
+    if (text.isEmpty()) {
+        return;
+    }
+    QString message = tr("\"%1\" needs more than the %2 MB undo limit, it and the edits before it cannot be undone.")
+            .arg(text)
+            .arg(journal.getMemoryLimit() / (1024 * 1024));
+    mw->logSink->append(LogSink::Warning, "Undo", message);
+    mw->statusBar()->showMessage(message, 10000);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Matrix Batch Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Group any number of edits, e.g. a scripted recoding of many cells. Until commitBatch() the views are
+// not refreshed, and the edits are undone and redone as one step named by text. Batches may be nested,
+// only the outermost commit does the work.
+void Matrix::beginBatch(QString text)
+{
+    if (batchDepth++ == 0) {
+        journal.beginGroup(text);
+        beginBatchUpdate();
+    }
+}
+
+void Matrix::commitBatch()
+{
+    if (batchDepth == 0) {
+        return;
+    }
+    if (--batchDepth == 0) {
+        journal.endGroup();
+        warnIfDropped();
+        endBatchUpdate();
+    }
+}
+
+void Matrix::beginBatchUpdate()
+{
+    isBatchUpdate = true;
+    hasBatchItemChanged = false;
+    leftTableModel->beginBatch();
+    rightTableModel->beginBatch();
+}
+
+// One view notification, one modified flag update and one dock refresh for everything since beginBatchUpdate()
+void Matrix::endBatchUpdate()
+{
+    isBatchUpdate = false;
+    bool isReset = leftTableModel->endBatch();
+    isReset = rightTableModel->endBatch() || isReset;
+
+    if (isReset) {
+        initializeSelection();
+    }
+    if (currentSelectedCell.first > -1 && currentSelectedCell.second > -1) {
+        QPair<int,int> locator = cellLocator(currentSelectedCell.first, currentSelectedCell.second);
+        currentSelectedCellData = cellState(locator.first, locator.second);
+    }
+
+    setWindowModified(isModified);
+    if (isReset || hasBatchItemChanged) {
+        mw->updateInformationDock();
+        mw->updateTaxaDock();
+        mw->updateCharacterDock();
+    }
+    mw->updateDataDock();
+    mw->updateEditMenu();
+}
+
+// Apply an entry backwards (undo) or forwards (redo)
+void Matrix::applyEntry(MatrixJournal::Entry &entry, bool isUndo)
+{
+    switch (entry.type) {
+    case MatrixJournal::CellEdit:
+        applyCellDeltas(entry, isUndo);
+        break;
+
+    case MatrixJournal::TaxonEdit: {
+        int row = taxonPosition(entry.id);
+        taxonList[row].setLabel(isUndo ? entry.oldLabel : entry.newLabel);
+        taxonList[row].setNotes(isUndo ? entry.oldNotes : entry.newNotes);
+        taxonList[row].setIsEnabled(isUndo ? entry.oldIsEnabled : entry.newIsEnabled);
+        markTaxonDirty(entry.id);
+        leftTableModel->taxonChanged(row);
+        hasBatchItemChanged = true;
+        isModified = true;
+        break;
+    }
+    case MatrixJournal::CharacterEdit: {
+        int column = characterPosition(entry.id);
+        characterList[column].setLabel(isUndo ? entry.oldLabel : entry.newLabel);
+        characterList[column].setNotes(isUndo ? entry.oldNotes : entry.newNotes);
+        characterList[column].setIsEnabled(isUndo ? entry.oldIsEnabled : entry.newIsEnabled);
+        characterList[column].setIsOrdered(isUndo ? entry.oldIsOrdered : entry.newIsOrdered);
+        markCharacterDirty(entry.id);
+        hasBatchItemChanged = true;
+        isModified = true;
+        break;
+    }
+    case MatrixJournal::InsertTaxa:
+    case MatrixJournal::RemoveTaxa:
+        if ((entry.type == MatrixJournal::InsertTaxa) == isUndo) {
+            removeTaxaBlock(entry.first, entry.count);
+        } else {
+            restoreTaxaBlock(entry);
+        }
+        break;
+
+    case MatrixJournal::MoveTaxa:
+        if (isUndo) {
+            moveTaxaBlock(entry.destination, entry.count, entry.first);
+        } else {
+            moveTaxaBlock(entry.first, entry.count, entry.destination);
+        }
+        break;
+
+    case MatrixJournal::InsertCharacters:
+    case MatrixJournal::RemoveCharacters:
+        if ((entry.type == MatrixJournal::InsertCharacters) == isUndo) {
+            removeCharactersBlock(entry.first, entry.count);
+        } else {
+            restoreCharactersBlock(entry);
+        }
+        break;
+
+    case MatrixJournal::MoveCharacters:
+        if (isUndo) {
+            moveCharactersBlock(entry.destination, entry.count, entry.first);
+        } else {
+            moveCharactersBlock(entry.first, entry.count, entry.destination);
+        }
+        break;
+    }
+}
+
+// Undo walks the deltas backwards so a cell edited more than once in a batch ends up at its first value
+void Matrix::applyCellDeltas(MatrixJournal::Entry &entry, bool isUndo)
+{
+    int cellCount = entry.cells.count();
+    for (int i = 0; i < cellCount; i++) {
+        const MatrixJournal::CellDelta &delta = entry.cells.at(isUndo ? cellCount-1-i : i);
+        if (isUndo) {
+            matrixGrid.setCellData(delta.taxonID, delta.characterID, delta.oldStateSet, delta.oldFlags);
+        } else {
+            matrixGrid.setCellData(delta.taxonID, delta.characterID, delta.newStateSet, delta.newFlags);
+        }
+        markRowDirty(delta.taxonID);
+        rightTableModel->cellChanged(taxonPosition(delta.taxonID), characterPosition(delta.characterID));
+    }
+
+    int noteCount = entry.notes.count();
+    for (int i = 0; i < noteCount; i++) {
+        const MatrixJournal::NoteDelta &delta = entry.notes.at(isUndo ? noteCount-1-i : i);
+        setCellNotes(delta.taxonID, delta.characterID, (isUndo ? delta.oldNotes : delta.newNotes));
+    }
+    isModified = true;
+}
+
+// Copy count taxa from row first together with their cells and notes into a journal entry
+MatrixJournal::Entry Matrix::captureTaxa(int first, int count, MatrixJournal::EntryType type)
+{
+    MatrixJournal::Entry entry;
+    entry.type = type;
+    if (type == MatrixJournal::InsertTaxa) {
+        entry.text = (count == 1 ? tr("Insert Taxon") : tr("Insert Taxa"));
+    } else {
+        entry.text = (count == 1 ? tr("Delete Taxon") : tr("Delete Taxa"));
+    }
+    entry.first = first;
+    entry.count = count;
+
+    int columns = charactersCount();
+    entry.crossIDs.reserve(columns);
+    for (int c = 0; c < columns; c++) {
+        entry.crossIDs.append(characterIDAt(c));
+    }
+
+    MatrixJournal::reserveCells(entry, matrixGrid.bytesPerCell(), count * columns);
+    QSet<int> taxonIDs;
+    for (int row = first; row < first + count; row++) {
+        Taxon taxon = taxonList[row];
+        int taxonID = taxon.getID();
+        entry.taxa.append(taxon);
+        taxonIDs.insert(taxonID);
+        for (int c = 0; c < columns; c++) {
+            int characterID = entry.crossIDs.at(c);
+            MatrixJournal::appendCell(entry, matrixGrid.getStateSet(taxonID, characterID), matrixGrid.getFlags(taxonID, characterID));
+        }
+    }
+
+    QHashIterator<QPair<int,int>, QString> i(cellNotesTable);
+    while (i.hasNext()) {
+        i.next();
+        if (taxonIDs.contains(i.key().first)) {
+            MatrixJournal::NoteDelta note;
+            note.taxonID = i.key().first;
+            note.characterID = i.key().second;
+            note.oldNotes = i.value();
+            entry.notes.append(note);
+        }
+    }
+
+    return entry;
+}
+
+// Copy count characters from column first together with their cells and notes into a journal entry
+MatrixJournal::Entry Matrix::captureCharacters(int first, int count, MatrixJournal::EntryType type)
+{
+    MatrixJournal::Entry entry;
+    entry.type = type;
+    if (type == MatrixJournal::InsertCharacters) {
+        entry.text = (count == 1 ? tr("Insert Character") : tr("Insert Characters"));
+    } else {
+        entry.text = (count == 1 ? tr("Delete Character") : tr("Delete Characters"));
+    }
+    entry.first = first;
+    entry.count = count;
+
+    int rows = taxaCount();
+    entry.crossIDs.reserve(rows);
+    for (int t = 0; t < rows; t++) {
+        entry.crossIDs.append(taxonIDAt(t));
+    }
+
+    MatrixJournal::reserveCells(entry, matrixGrid.bytesPerCell(), count * rows);
+    QSet<int> characterIDs;
+    for (int column = first; column < first + count; column++) {
+        Character character = characterList[column];
+        int characterID = character.getID();
+        entry.characters.append(character);
+        characterIDs.insert(characterID);
+        for (int t = 0; t < rows; t++) {
+            int taxonID = entry.crossIDs.at(t);
+            MatrixJournal::appendCell(entry, matrixGrid.getStateSet(taxonID, characterID), matrixGrid.getFlags(taxonID, characterID));
+        }
+    }
+
+    QHashIterator<QPair<int,int>, QString> i(cellNotesTable);
+    while (i.hasNext()) {
+        i.next();
+        if (characterIDs.contains(i.key().second)) {
+            MatrixJournal::NoteDelta note;
+            note.taxonID = i.key().first;
+            note.characterID = i.key().second;
+            note.oldNotes = i.value();
+            entry.notes.append(note);
+        }
+    }
+
+    return entry;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Matrix ID/Position Index Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Row of a taxon, -1 if there is no such taxon
+int Matrix::taxonPosition(int taxonID)
+{
+    refreshTaxonIndex();
+    return taxonPositions.value(taxonID, -1);
+}
+
+int Matrix::taxonIDAt(int row)
+{
+    return taxonList[row].getID();
+}
+
+// Column of a character, -1 if there is no such character
+int Matrix::characterPosition(int characterID)
+{
+    refreshCharacterIndex();
+    return characterPositions.value(characterID, -1);
+}
+
+int Matrix::characterIDAt(int column)
+{
+    return characterList[column].getID();
+}
+
+// Resolve a table row/column to a cell locator, i.e. (taxonID, characterID)
+QPair<int,int> Matrix::cellLocator(int row, int column)
+{
+    return returnLocator(taxonIDAt(row), characterIDAt(column));
+}
+
+// The index entries from a row on are stale, they are rebuilt on the next lookup. Repeated inserts and
+// removals therefore cost one pass over the rows they touched rather than one pass each.
+void Matrix::invalidateTaxonIndex(int row)
+{
+    if (taxonIndexDirtyFrom < 0 || row < taxonIndexDirtyFrom) {
+        taxonIndexDirtyFrom = row;
+    }
+}
+
+void Matrix::refreshTaxonIndex()
+{
+    if (taxonIndexDirtyFrom < 0) {
+        return;
+    }
+    for (int row = taxonIndexDirtyFrom; row < taxonList.count(); row++) {
+        taxonPositions.insert(taxonList[row].getID(), row);
+    }
+    taxonIndexDirtyFrom = -1;
+}
+
+// Rows first to last-1 have changed places among themselves (a move), bring their entries up to date now. Any
+// of them already waiting to be rebuilt are left to refreshTaxonIndex().
+void Matrix::updateTaxonIndex(int first, int last)
+{
+    if (taxonIndexDirtyFrom >= 0) {
+        last = qMin(last, taxonIndexDirtyFrom);
+    }
+    for (int row = first; row < last; row++) {
+        taxonPositions.insert(taxonList[row].getID(), row);
+    }
+}
+
+void Matrix::invalidateCharacterIndex(int column)
+{
+    if (characterIndexDirtyFrom < 0 || column < characterIndexDirtyFrom) {
+        characterIndexDirtyFrom = column;
+    }
+}
+
+void Matrix::refreshCharacterIndex()
+{
+    if (characterIndexDirtyFrom < 0) {
+        return;
+    }
+    for (int column = characterIndexDirtyFrom; column < characterList.count(); column++) {
+        characterPositions.insert(characterList[column].getID(), column);
+    }
+    characterIndexDirtyFrom = -1;
+}
+
+void Matrix::updateCharacterIndex(int first, int last)
+{
+    if (characterIndexDirtyFrom >= 0) {
+        last = qMin(last, characterIndexDirtyFrom);
+    }
+    for (int column = first; column < last; column++) {
+        characterPositions.insert(characterList[column].getID(), column);
+    }
+}
+
+// Position of an item after moveBlock(list, first, count, destination), -1 stays -1
+int Matrix::movedPosition(int position, int first, int count, int destination)
+{
+    if (position < 0) {
+        return position;
+    }
+    if (position >= first && position < first + count) {
+        return destination + (position - first);
+    }
+    if (destination > first && position >= first + count && position < destination + count) {
+        return position - count;
+    }
+    if (destination < first && position >= destination && position < first) {
+        return position + count;
+    }
+    return position;
 }
 
 // Create Cell Locator
@@ -1149,26 +2301,7 @@ QPair<int,int> Matrix::returnLocator(int taxonID, int characterID)
 // Check symbol against data in cell
 bool Matrix::isSymbolSelected(QString symbol, int taxonID, int characterID)
 {
-    Cell *currentCell = matrixGrid.value(returnLocator(taxonID, characterID));
-    QString input = currentCell->getState();
-
-    if (input.size() == 1) {
-        if (symbol == input) {
-            return true;
-        } else {
-            return false;
-        }
-    } else {
-        bool returnValue = false;
-        if ((input.startsWith("{") && input.endsWith("}")) || (input.startsWith("(") && input.endsWith(")"))) {
-            for (int i = 1; i < input.size()-1; ++i) {
-                if(input.at(i) == symbol){
-                    returnValue = true;
-                }
-            }
-        }
-        return returnValue;
-    }
+    return matrixGrid.isSymbolSelected(symbol, taxonID, characterID);
 }
 
 // Check symbol against allowed states
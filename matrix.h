@@ -23,23 +23,36 @@
 #include <QtGui>
 #include <QWidget>
 
+#include <algorithm>
+
 #include "mainwindow.h"
 #include "settings.h"
 #include "taxon.h"
 #include "character.h"
 #include "cell.h"
 #include "equate.h"
+#include "matrixgrid.h"
+#include "matrixtablemodel.h"
+#include "matrixjournal.h"
+#include "autosavejournal.h"
 
 class MainWindow;
 class Settings;
 class Cell;
+class MatrixTableModel;
+class MatrixCellDelegate;
+class NexusParserCharactersBlock;
+class Database;
 
 class Matrix : public QWidget, Ui::matrixTableForm
 {
     Q_OBJECT
 
+    // Reads and writes the private matrix details when a .made file is opened or saved
+    friend class Database;
+
 public:
-    Matrix();
+    Matrix(MainWindow *mainwindow, Settings *mainSettings);
 
     Matrix *matrix;
     MainWindow *mw;
@@ -55,31 +68,49 @@ public:
     void charactersDialog(int column);
 
     void newFile();
+    void importNexus(QString name, NexusParserCharactersBlock *charactersBlock);
     bool loadFile(QString fileName);
+    bool recoverFile(QString journalFile);
     bool saveCheck();
     bool saveFileAs();
     bool saveFile(QString fileName);
 
     void moveRow(int row, bool up);
+    bool moveTaxa(int first, int count, int destination);
     void deleteRow(int row);
+    bool deleteRows(int first, int count);
     void insertRow(int row);
 
+    bool editCell(int row, int column, QString text);
+
     void moveColumn(int column, bool left);
+    bool moveCharacters(int first, int count, int destination);
     void insertColumn(int column);
     void deleteColumn(int column);
+    bool deleteColumns(int first, int count);
+
+    void beginBatch(QString text);
+    void commitBatch();
+
+    void undo();
+    void redo();
+    bool canUndo();
+    bool canRedo();
+    QString undoText();
+    QString redoText();
+    void setUndoMemoryLimit(qint64 bytes);
 
     int nextTaxonID;
     QList <Taxon> taxonList;
     bool taxonAdd(QString name, QString notes);
-    bool taxonEdit(int key, QString name, QString notes);
+    bool taxonEdit(int key, QString name, QString notes, bool isEnabled);
     bool taxonRemove(int row);
     int taxaCount();
-    void updateLeftTableText(int row, QString text);
 
     int nextCharacterID;
     QList <Character> characterList;
     bool characterAdd(QString name, QString notes);
-    bool characterEdit(int key, QString name, QString notes);
+    bool characterEdit(int key, QString name, QString notes, bool isEnabled, bool isOrdered);
     bool charactersRemove(int column);
     int charactersCount();
 
@@ -109,15 +140,25 @@ public:
     bool isSymbolSelected(QString symbol, int taxonID, int characterID);
     bool isSymbolAllowed(QString symbol, int characterID);
 
-    QHash<QPair<int, int>, Cell*> matrixGrid;
+    MatrixGrid matrixGrid;
     bool cellAdd(int taxonID, int characterID, QString state, QString notes);
     bool cellEdit(int taxonID, int characterID, QString state, QString notes);
     bool cellRemove(int taxonID, int characterID);
     int cellCount();
-
+    QString cellState(int taxonID, int characterID);
+    bool hasCellNotes(int taxonID, int characterID);
+    QString cellNotes(int taxonID, int characterID);
+    void setCellNotes(int taxonID, int characterID, QString notes);
+    qint64 memoryUsage();
+
+    int taxonPosition(int taxonID);
+    int taxonIDAt(int row);
+    int characterPosition(int characterID);
+    int characterIDAt(int column);
+    QPair<int,int> cellLocator(int row, int column);
     QPair<int,int> returnLocator(int taxonID, int characterID);
-    QPair<int,int> *currentSelectedCell;
-    QPair<int,int> *previousSelectedCell;
+    QPair<int,int> currentSelectedCell;
+    QPair<int,int> previousSelectedCell;
     QBrush currentSelectedCellColor;
     QBrush previousSelectedCellColor;
     QString currentSelectedCellData;
@@ -128,6 +169,25 @@ protected:
 private:    
     bool isUntitled;
     bool isModified;
+
+    // What has changed since the file was last saved or opened, so that saveFile() only writes that. Cells are
+    // tracked a taxon row at a time, adding or removing characters changes every row.
+    bool canSaveChanges;
+    bool isTaxonListDirty;
+    bool isCharacterListDirty;
+    bool hasAllRowsDirty;
+    QSet<int> dirtyTaxonRows;
+    QSet<int> dirtyTaxa;
+    QSet<int> dirtyCharacters;
+    QSet<QPair<int,int> > dirtyNotes;
+    QVector<int> savedCharacterOrder;
+    void markRowDirty(int taxonID);
+    void markNotesDirty(int taxonID, int characterID);
+    void markTaxonDirty(int taxonID);
+    void markCharacterDirty(int characterID);
+    void markTaxonListDirty();
+    void markCharacterListDirty(bool isRowsChanged);
+    void resetDirtyRegions(bool canSave);
     bool isSelected;
     QString currentFile;
     QString missingCharacter;
@@ -139,13 +199,93 @@ private:
     QList<QVariant> disallowedCharactersList;
     QList<QVariant> matrixTypesList;
 
+    // ID to position index, kept in step with taxonList/characterList. The order of those lists is the
+    // row/column order of the matrix, cells are stored by ID and never move when it changes.
+    QHash<int,int> taxonPositions;
+    QHash<int,int> characterPositions;
+    int taxonIndexDirtyFrom;
+    int characterIndexDirtyFrom;
+    void invalidateTaxonIndex(int row);
+    void refreshTaxonIndex();
+    void updateTaxonIndex(int first, int last);
+    void invalidateCharacterIndex(int column);
+    void refreshCharacterIndex();
+    void updateCharacterIndex(int first, int last);
+    int movedPosition(int position, int first, int count, int destination);
+
+    // Move count items starting at first so that the first of them ends up at destination, as one rotation of
+    // the items between the block and its destination
+    template <typename T> void moveBlock(QList<T> &list, int first, int count, int destination)
+    {
+        if (destination > first) {
+            std::rotate(list.begin() + first, list.begin() + first + count, list.begin() + destination + count);
+        } else if (destination < first) {
+            std::rotate(list.begin() + destination, list.begin() + first, list.begin() + first + count);
+        }
+    }
+
+    // Insert items so that the first of them ends up at first, shifting the tail once
+    template <typename T> void insertBlock(QList<T> &list, int first, QList<T> items)
+    {
+        QList<T> tail = list.mid(first);
+        list.erase(list.begin() + first, list.end());
+        list.append(items);
+        list.append(tail);
+    }
+
+    // Sparse cell notes, only cells that have notes have an entry
+    QHash<QPair<int,int>, QString> cellNotesTable;
+    void removeTaxaNotes(QSet<int> taxonIDs);
+    void removeCharactersNotes(QSet<int> characterIDs);
+    void releaseCells();
+
+    // Crash recovery, every change is also appended to an autosave journal until the matrix is saved or closed.
+    // An untitled matrix gets a snapshot for it to apply to when it is created or imported.
+    AutosaveJournal *autosaveJournal;
+    bool isAutosaveOff;
+    bool isReplaying;
+    int journaledSymbols;
+    bool startAutosave();
+    void stopAutosave();
+    void autosave(AutosaveJournal::RecordType type, QByteArray payload);
+    void autosaveEntry(MatrixJournal::Entry &entry, bool isUndo);
+    void autosaveDetails();
+    void autosaveCharacters();
+    void replayRecord(AutosaveJournal::Record &record, QVector<int> &symbolBits);
+
+    // Undo/redo history, edits are recorded after they have been applied
+    MatrixJournal journal;
+    int batchDepth;
+    bool isBatchUpdate;
+    bool hasBatchItemChanged;
+    void beginBatchUpdate();
+    void endBatchUpdate();
+    void recordEntry(MatrixJournal::Entry entry);
+    void warnIfDropped();
+    void applyEntry(MatrixJournal::Entry &entry, bool isUndo);
+    void applyCellDeltas(MatrixJournal::Entry &entry, bool isUndo);
+    MatrixJournal::Entry captureTaxa(int first, int count, MatrixJournal::EntryType type);
+    MatrixJournal::Entry captureCharacters(int first, int count, MatrixJournal::EntryType type);
+    void removeTaxaBlock(int first, int count);
+    void restoreTaxaBlock(MatrixJournal::Entry &entry);
+    void moveTaxaBlock(int first, int count, int destination);
+    void removeCharactersBlock(int first, int count);
+    void restoreCharactersBlock(MatrixJournal::Entry &entry);
+    void moveCharactersBlock(int first, int count, int destination);
+
     int totalNumberProcessed;
     int totalNumberToProcess;
     bool wasCanceled;
     QProgressDialog *progress;
 
+    MatrixTableModel *leftTableModel;
+    MatrixTableModel *rightTableModel;
+    MatrixCellDelegate *cellDelegate;
+
     void initializeMatrixTable ();
+    void beginSetupMatrixTable();
     void setupMatrixTable();
+    void finishLoading();
     bool maybeSaveCheck();
     void setCurrentFile(QString fileName);
     QString strippedName(QString fullFileName);
@@ -153,30 +293,13 @@ private:
     void initializeSelection();
     void resetSelection();
 
-    void moveRowLeftTable(int row, bool up);
-    void moveRowRightTable(int row, bool up);
-    void deleteRowLeftTable(int row);
-    void deleteRowRightTable(int row);
-    void insertRowLeftTable(int row);
-    void insertRowRightTable(int row);
-    void updateVerticalHeadersRightTable();
-    void updateVerticalHeadersLeftTable();
-    QList<QTableWidgetItem*> getRowLeftTable(int row);
-    void setRowLeftTable(int row, const QList<QTableWidgetItem*>& rowItems);
-    QList<QTableWidgetItem*> getRowRightTable(int row);
-    void setRowRightTable(int row, const QList<QTableWidgetItem*>& rowItems);
-
-    void updateHorizontalHeadersRightTable();
-    QList<QTableWidgetItem*> getColumn(int column);
-    void setColumn(int column, const QList<QTableWidgetItem*>& columnItems);
-
 private slots:
     void updateHorizontalScrollbarRange(int min, int max);
     void updateVerticalScrollbarRange(int min, int max);
     void updateSplitter(int min, int max);
     void updateRightTableSelectionChanged(const QModelIndex & current, const QModelIndex & previous);
     void rightTableContexMenu(const QPoint& pos);
-    void updateRightTableCellChanged(QTableWidgetItem * item);
+    void editCurrentCellNotes();
     void horizontalHeaderRightTableDoubleClick(int column);
     void verticalHeaderLeftTableDoubleClick(int row);
     void verticalHeaderRightTableDoubleClick(int row);
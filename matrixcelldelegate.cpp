@@ -0,0 +1,167 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "matrixcelldelegate.h"
+#include "matrixgrid.h"
+#include "matrixtablemodel.h"
+
+MatrixCellDelegate::MatrixCellDelegate(QObject *parent) :
+    QStyledItemDelegate(parent)
+{
+    classColors[StateColor] = QColor(Qt::black);
+    classColors[PolymorphicColor] = QColor(0,0,160);
+    classColors[UncertainColor] = QColor(0,110,0);
+    classColors[MissingColor] = QColor(Qt::gray);
+    classColors[GapColor] = QColor(Qt::gray);
+    glyphPixelRatio = 1.0;
+
+    // The view's font is the one cells are painted in, a change to it invalidates the cache
+    if (parent && parent->isWidgetType()) {
+        parent->installEventFilter(this);
+    }
+}
+
+void MatrixCellDelegate::setClassColor(ColorClass colorClass, QColor color)
+{
+    classColors[colorClass] = color;
+    clearGlyphCache();
+}
+
+void MatrixCellDelegate::clearGlyphCache()
+{
+    glyphCache.clear();
+}
+
+bool MatrixCellDelegate::eventFilter(QObject *object, QEvent *event)
+{
+    if (event->type() == QEvent::FontChange) {
+        clearGlyphCache();
+    }
+    return QStyledItemDelegate::eventFilter(object, event);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Paint Functions
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixCellDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const MatrixTableModel *model = qobject_cast<const MatrixTableModel *>(index.model());
+    if (!model) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    // Background, i.e. the selected cell colour or the alternating row colour
+    if (model->isSelectedCell(index.row(), index.column())) {
+        painter->fillRect(option.rect, model->selectedCellBrush());
+    } else if (option.features & QStyleOptionViewItem::Alternate) {
+        painter->fillRect(option.rect, option.palette.brush(QPalette::AlternateBase));
+    }
+
+    quint64 stateSet;
+    int flags;
+    model->getCell(index.row(), index.column(), stateSet, flags);
+    if (stateSet == 0 && flags == 0) {
+        return;
+    }
+
+    ColorClass colorClass = colorClassForFlags(flags);
+    QPixmap pixmap = glyph(index, colorClass, stateSet, option);
+    if (pixmap.isNull()) {
+        return;
+    }
+
+    // Centre the glyph, clipping it if the text is wider than the cell
+    QSize size = pixmap.size() / pixmap.devicePixelRatio();
+    QPoint topLeft(option.rect.x() + (option.rect.width() - size.width())/2,
+                   option.rect.y() + (option.rect.height() - size.height())/2);
+    if (size.width() > option.rect.width() || size.height() > option.rect.height()) {
+        painter->save();
+        painter->setClipRect(option.rect);
+        painter->drawPixmap(topLeft, pixmap);
+        painter->restore();
+    } else {
+        painter->drawPixmap(topLeft, pixmap);
+    }
+}
+
+MatrixCellDelegate::ColorClass MatrixCellDelegate::colorClassForFlags(int flags) const
+{
+    if (flags & MatrixGrid::MissingFlag) {
+        return MissingColor;
+    }
+    if (flags & MatrixGrid::GapFlag) {
+        return GapColor;
+    }
+    if (flags & MatrixGrid::PolymorphicFlag) {
+        return PolymorphicColor;
+    }
+    if (flags & MatrixGrid::UncertainFlag) {
+        return UncertainColor;
+    }
+    return StateColor;
+}
+
+// Return the pre-rendered glyph for a state set and colour class, rendering the cell's text on first use
+QPixmap MatrixCellDelegate::glyph(const QModelIndex &index, ColorClass colorClass, quint64 stateSet, const QStyleOptionViewItem &option) const
+{
+    // A change of screen invalidates everything rendered so far
+    qreal pixelRatio = 1.0;
+    if (option.widget) {
+        pixelRatio = option.widget->devicePixelRatio();
+    }
+    if (pixelRatio != glyphPixelRatio) {
+        glyphCache.clear();
+        glyphPixelRatio = pixelRatio;
+    }
+
+    // Missing and gap cells show their symbol whatever the state set
+    if (colorClass == MissingColor || colorClass == GapColor) {
+        stateSet = 0;
+    }
+    QPair<int, quint64> key(colorClass, stateSet);
+    QHash<QPair<int, quint64>, QPixmap>::const_iterator i = glyphCache.constFind(key);
+    if (i != glyphCache.constEnd()) {
+        return i.value();
+    }
+
+    QString text = index.data(Qt::DisplayRole).toString();
+    QPixmap pixmap;
+    if (!text.isEmpty()) {
+        QFontMetrics metrics(option.font);
+        QSize size(metrics.horizontalAdvance(text) + 2, metrics.height());
+
+        pixmap = QPixmap(size * pixelRatio);
+        pixmap.setDevicePixelRatio(pixelRatio);
+        pixmap.fill(Qt::transparent);
+
+        QPainter glyphPainter(&pixmap);
+        glyphPainter.setFont(option.font);
+        glyphPainter.setPen(classColors[colorClass]);
+        glyphPainter.drawText(QRect(QPoint(0, 0), size), Qt::AlignCenter, text);
+        glyphPainter.end();
+    }
+
+    // State sets are few, but guard against unbounded growth from odd input
+    if (glyphCache.count() >= maxCachedGlyphs) {
+        glyphCache.clear();
+    }
+    glyphCache.insert(key, pixmap);
+
+    return pixmap;
+}
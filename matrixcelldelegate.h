@@ -0,0 +1,65 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef MATRIXCELLDELEGATE_H
+#define MATRIXCELLDELEGATE_H
+
+#include <QtGui>
+#include <QStyledItemDelegate>
+
+// Item delegate for the matrix data table. Cell text is short ("0", "(01)", "{AG}") and repeats endlessly,
+// so each distinct state set is laid out once per colour class into a pixmap and the pixmap is blitted when
+// painting. The cell is read straight from the MatrixTableModel and the cache is keyed on integers, so a cached
+// cell is painted without building any strings. Editing is left to QStyledItemDelegate.
+class MatrixCellDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    MatrixCellDelegate(QObject *parent = 0);
+
+    enum ColorClass {
+        StateColor = 0,
+        PolymorphicColor,
+        UncertainColor,
+        MissingColor,
+        GapColor,
+        ColorClassCount
+    };
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+    void setClassColor(ColorClass colorClass, QColor color);
+    void clearGlyphCache();
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event);
+
+private:
+    static const int maxCachedGlyphs = 4096;
+
+    QColor classColors[ColorClassCount];
+
+    // Keyed on colour class and state set, the missing and gap symbols are cleared with clearGlyphCache()
+    mutable QHash<QPair<int, quint64>, QPixmap> glyphCache;
+    mutable qreal glyphPixelRatio;
+
+    ColorClass colorClassForFlags(int flags) const;
+    QPixmap glyph(const QModelIndex &index, ColorClass colorClass, quint64 stateSet, const QStyleOptionViewItem &option) const;
+};
+
+#endif // MATRIXCELLDELEGATE_H
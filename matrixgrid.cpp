@@ -0,0 +1,599 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "matrixgrid.h"
+
+// Read a state set of the given byte width (stored little endian)
+static quint64 loadStateSet(const uchar *data, int width)
+{
+    switch (width) {
+    case 1:
+        return *data;
+    case 2:
+        return qFromLittleEndian<quint16>(data);
+    case 4:
+        return qFromLittleEndian<quint32>(data);
+    default:
+        return qFromLittleEndian<quint64>(data);
+    }
+}
+
+MatrixGrid::MatrixGrid()
+{
+    missingSymbol = "?";
+    gapSymbol = "-";
+    clear();
+}
+
+//-- Release all cells and symbols
+void MatrixGrid::clear()
+{
+    stateWidth = 1;
+    rowCapacity = 0;
+    columnCapacity = 0;
+    rowsUsed = 0;
+    columnsUsed = 0;
+
+    stateData.clear();
+    for (int p = 0; p < PlaneCount; p++) {
+        flagPlanes[p].clear();
+    }
+
+    rowSlots.clear();
+    columnSlots.clear();
+    freeRowSlots.clear();
+    freeColumnSlots.clear();
+
+    symbols.clear();
+    symbolDecodeOrder.clear();
+    memset(asciiSymbolLookup, -1, sizeof(asciiSymbolLookup));
+}
+
+//-- Pre-allocate room for a number of taxa and characters
+void MatrixGrid::reserve(int rows, int columns)
+{
+    if (rows > rowCapacity || columns > columnCapacity) {
+        resizeStorage(qMax(rows, rowCapacity), qMax(columns, columnCapacity));
+    }
+}
+
+//-- Exchange all cells and symbols with another grid, without copying any cell data
+void MatrixGrid::swap(MatrixGrid &other)
+{
+    qSwap(stateWidth, other.stateWidth);
+    qSwap(rowCapacity, other.rowCapacity);
+    qSwap(columnCapacity, other.columnCapacity);
+    qSwap(rowsUsed, other.rowsUsed);
+    qSwap(columnsUsed, other.columnsUsed);
+
+    stateData.swap(other.stateData);
+    for (int p = 0; p < PlaneCount; p++) {
+        qSwap(flagPlanes[p], other.flagPlanes[p]);
+    }
+
+    rowSlots.swap(other.rowSlots);
+    columnSlots.swap(other.columnSlots);
+    freeRowSlots.swap(other.freeRowSlots);
+    freeColumnSlots.swap(other.freeColumnSlots);
+
+    symbols.swap(other.symbols);
+    symbolDecodeOrder.swap(other.symbolDecodeOrder);
+    for (int i = 0; i < 128; i++) {
+        qSwap(asciiSymbolLookup[i], other.asciiSymbolLookup[i]);
+    }
+    missingSymbol.swap(other.missingSymbol);
+    gapSymbol.swap(other.gapSymbol);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Symbol Functions
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixGrid::setMissingSymbol(QString symbol)
+{
+    missingSymbol = symbol;
+}
+
+void MatrixGrid::setGapSymbol(QString symbol)
+{
+    gapSymbol = symbol;
+}
+
+// Symbols in bit order, i.e. symbols.at(n) is bit n of a state set
+QString MatrixGrid::getSymbols()
+{
+    return symbols;
+}
+
+int MatrixGrid::symbolIndex(QChar symbol)
+{
+    if (symbol.unicode() < 128) {
+        return asciiSymbolLookup[symbol.unicode()];
+    }
+    return symbols.indexOf(symbol);
+}
+
+// Register a new symbol, widening the stored state sets if it no longer fits
+int MatrixGrid::addSymbol(QChar symbol)
+{
+    if (symbols.size() >= maxSymbols) {
+        return -1;
+    }
+
+    int bit = symbols.size();
+    symbols.append(symbol);
+    if (symbol.unicode() < 128) {
+        asciiSymbolLookup[symbol.unicode()] = bit;
+    }
+
+    // Keep decoding in symbol order rather than the order symbols were first seen
+    int position = 0;
+    while (position < symbolDecodeOrder.count() && symbols.at(symbolDecodeOrder.at(position)) < symbol) {
+        position++;
+    }
+    symbolDecodeOrder.insert(position, bit);
+
+    int width = 1;
+    while (width * 8 < symbols.size()) {
+        width *= 2;
+    }
+    if (width > stateWidth) {
+        setStateWidth(width);
+    }
+
+    return bit;
+}
+
+/*------------------------------------------------------------------------------------/
+ * State Encoding Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Convert state text, e.g. "0", "(01)", "{AG}", "?" or "-", into a state set and flags
+bool MatrixGrid::encodeState(QString state, quint64 &stateSet, int &flags)
+{
+    stateSet = 0;
+    flags = 0;
+
+    QString input = state.trimmed();
+    if (input.isEmpty()) {
+        return true;
+    }
+    if (input == missingSymbol) {
+        flags = MissingFlag;
+        return true;
+    }
+    if (input == gapSymbol) {
+        flags = GapFlag;
+        return true;
+    }
+
+    int first = 0;
+    int last = input.size();
+    if (input.size() > 1) {
+        if (input.startsWith("(") && input.endsWith(")")) {
+            flags = PolymorphicFlag;
+            first = 1;
+            last = input.size()-1;
+        } else if (input.startsWith("{") && input.endsWith("}")) {
+            flags = UncertainFlag;
+            first = 1;
+            last = input.size()-1;
+        } else {
+            // Unbracketed multiple symbols are treated as polymorphic, as in the matrix editor
+            flags = PolymorphicFlag;
+        }
+    }
+
+    for (int i = first; i < last; ++i) {
+        QChar symbol = input.at(i);
+        if (symbol.isSpace()) {
+            continue;
+        }
+        if (missingSymbol == symbol || gapSymbol == symbol) {
+            return false;
+        }
+        int bit = symbolIndex(symbol);
+        if (bit == -1) {
+            bit = addSymbol(symbol);
+            if (bit == -1) {
+                return false;
+            }
+        }
+        stateSet |= (Q_UINT64_C(1) << bit);
+    }
+
+    return true;
+}
+
+// Convert a state set and flags back into state text
+QString MatrixGrid::decodeState(quint64 stateSet, int flags)
+{
+    if (flags & MissingFlag) {
+        return missingSymbol;
+    }
+    if (flags & GapFlag) {
+        return gapSymbol;
+    }
+
+    QString state;
+    for (int i = 0; i < symbolDecodeOrder.count(); i++) {
+        int bit = symbolDecodeOrder.at(i);
+        if (stateSet & (Q_UINT64_C(1) << bit)) {
+            state.append(symbols.at(bit));
+        }
+    }
+
+    if (flags & PolymorphicFlag) {
+        return "(" + state + ")";
+    }
+    if (flags & UncertainFlag) {
+        return "{" + state + "}";
+    }
+    return state;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Cell Functions
+ *-----------------------------------------------------------------------------------*/
+
+bool MatrixGrid::setCell(int taxonID, int characterID, QString state)
+{
+    quint64 stateSet;
+    int flags;
+    if (!encodeState(state, stateSet, flags)) {
+        return false;
+    }
+
+    setCellData(taxonID, characterID, stateSet, flags);
+    return true;
+}
+
+// Store an already encoded state set and flags, e.g. one read back from getStateSet()/getFlags()
+void MatrixGrid::setCellData(int taxonID, int characterID, quint64 stateSet, int flags)
+{
+    int row = rowSlot(taxonID);
+    if (row == -1) {
+        row = addRowSlot(taxonID);
+    }
+    int column = columnSlot(characterID);
+    if (column == -1) {
+        column = addColumnSlot(characterID);
+    }
+
+    int index = cellIndex(row, column);
+    writeStateSet(index, stateSet);
+    writeFlags(index, flags);
+}
+
+// Column of each character, adding any that are not in the grid yet. Used with setRowData() by readers that
+// write whole rows, so the column lookups are done once rather than once per cell.
+QVector<int> MatrixGrid::columnsFor(const QVector<int> &characterIDs)
+{
+    QVector<int> columns(characterIDs.count());
+    for (int i = 0; i < characterIDs.count(); i++) {
+        int column = columnSlot(characterIDs.at(i));
+        if (column == -1) {
+            column = addColumnSlot(characterIDs.at(i));
+        }
+        columns[i] = column;
+    }
+    return columns;
+}
+
+// Store count encoded cells of a taxon, cell i going to columns[first+i]. The state sets must already be in
+// the grid's symbol alphabet, i.e. come from encodeState(), so the stored width never changes part way.
+void MatrixGrid::setRowData(int taxonID, const QVector<int> &columns, int first, int count, const quint64 *stateSets, const quint8 *flags)
+{
+    int row = rowSlot(taxonID);
+    if (row == -1) {
+        row = addRowSlot(taxonID);
+    }
+
+    int rowIndex = cellIndex(row, 0);
+    for (int i = 0; i < count; i++) {
+        int index = rowIndex + columns.at(first + i);
+        writeStateSet(index, stateSets[i]);
+        writeFlags(index, flags[i]);
+    }
+}
+
+void MatrixGrid::clearCell(int taxonID, int characterID)
+{
+    int row = rowSlot(taxonID);
+    int column = columnSlot(characterID);
+    if (row != -1 && column != -1) {
+        clearIndex(cellIndex(row, column));
+    }
+}
+
+// Remove a whole taxon, its slot is cleared and reused by the next taxon added
+void MatrixGrid::removeRow(int taxonID)
+{
+    int row = rowSlot(taxonID);
+    if (row == -1) {
+        return;
+    }
+    for (int column = 0; column < columnsUsed; column++) {
+        clearIndex(cellIndex(row, column));
+    }
+    rowSlots.remove(taxonID);
+    freeRowSlots.append(row);
+}
+
+// Remove a whole character, its slot is cleared and reused by the next character added
+void MatrixGrid::removeColumn(int characterID)
+{
+    int column = columnSlot(characterID);
+    if (column == -1) {
+        return;
+    }
+    for (int row = 0; row < rowsUsed; row++) {
+        clearIndex(cellIndex(row, column));
+    }
+    columnSlots.remove(characterID);
+    freeColumnSlots.append(column);
+}
+
+bool MatrixGrid::hasCell(int taxonID, int characterID)
+{
+    return (rowSlot(taxonID) != -1 && columnSlot(characterID) != -1);
+}
+
+QString MatrixGrid::getState(int taxonID, int characterID)
+{
+    if (!hasCell(taxonID, characterID)) {
+        return QString();
+    }
+    int index = cellIndex(rowSlot(taxonID), columnSlot(characterID));
+    return decodeState(readStateSet(index), readFlags(index));
+}
+
+quint64 MatrixGrid::getStateSet(int taxonID, int characterID)
+{
+    if (!hasCell(taxonID, characterID)) {
+        return 0;
+    }
+    return readStateSet(cellIndex(rowSlot(taxonID), columnSlot(characterID)));
+}
+
+int MatrixGrid::getFlags(int taxonID, int characterID)
+{
+    if (!hasCell(taxonID, characterID)) {
+        return 0;
+    }
+    return readFlags(cellIndex(rowSlot(taxonID), columnSlot(characterID)));
+}
+
+// Check a single symbol (or the missing/gap symbol) against the data in a cell
+bool MatrixGrid::isSymbolSelected(QString symbol, int taxonID, int characterID)
+{
+    if (!hasCell(taxonID, characterID)) {
+        return false;
+    }
+
+    int index = cellIndex(rowSlot(taxonID), columnSlot(characterID));
+    int flags = readFlags(index);
+    if (symbol == missingSymbol) {
+        return (flags & MissingFlag);
+    }
+    if (symbol == gapSymbol) {
+        return (flags & GapFlag);
+    }
+    if (symbol.size() != 1) {
+        return false;
+    }
+
+    int bit = symbolIndex(symbol.at(0));
+    if (bit == -1) {
+        return false;
+    }
+    return (readStateSet(index) & (Q_UINT64_C(1) << bit));
+}
+
+int MatrixGrid::rowCount()
+{
+    return rowSlots.count();
+}
+
+int MatrixGrid::columnCount()
+{
+    return columnSlots.count();
+}
+
+int MatrixGrid::cellCount()
+{
+    return rowSlots.count() * columnSlots.count();
+}
+
+// Bytes used per cell for the state set, the flag planes add a further half byte
+int MatrixGrid::bytesPerCell()
+{
+    return stateWidth;
+}
+
+// Approximate bytes held by the grid, i.e. the state and flag arrays plus the slot tables. Freed
+// slots are reused rather than returned, so this stays flat while cells are edited in place.
+qint64 MatrixGrid::memoryUsage()
+{
+    qint64 bytes = stateData.capacity();
+    for (int p = 0; p < PlaneCount; p++) {
+        bytes += (flagPlanes[p].size() + 7) / 8;
+    }
+    bytes += (rowSlots.count() + columnSlots.count()) * (qint64)(3 * sizeof(int) + sizeof(void *));
+    bytes += (freeRowSlots.count() + freeColumnSlots.count()) * (qint64)sizeof(void *);
+    bytes += symbols.capacity() * sizeof(QChar);
+    return bytes;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Slot Functions
+ *-----------------------------------------------------------------------------------*/
+
+int MatrixGrid::rowSlot(int taxonID)
+{
+    return rowSlots.value(taxonID, -1);
+}
+
+int MatrixGrid::columnSlot(int characterID)
+{
+    return columnSlots.value(characterID, -1);
+}
+
+int MatrixGrid::addRowSlot(int taxonID)
+{
+    int row;
+    if (!freeRowSlots.isEmpty()) {
+        row = freeRowSlots.takeLast();
+    } else {
+        if (rowsUsed == rowCapacity) {
+            resizeStorage(qMax(rowCapacity*2, 8), columnCapacity);
+        }
+        row = rowsUsed++;
+    }
+    rowSlots.insert(taxonID, row);
+    return row;
+}
+
+int MatrixGrid::addColumnSlot(int characterID)
+{
+    int column;
+    if (!freeColumnSlots.isEmpty()) {
+        column = freeColumnSlots.takeLast();
+    } else {
+        if (columnsUsed == columnCapacity) {
+            resizeStorage(rowCapacity, qMax(columnCapacity*2, 8));
+        }
+        column = columnsUsed++;
+    }
+    columnSlots.insert(characterID, column);
+    return column;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Storage Functions
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixGrid::resizeStorage(int rows, int columns)
+{
+    int oldSize = rowCapacity * columnCapacity;
+    int newSize = rows * columns;
+
+    if (columns == columnCapacity) {
+        // Same row stride, existing cells keep their index
+        stateData.resize(newSize * stateWidth);
+        if (newSize > oldSize) {
+            memset(stateData.data() + (oldSize * stateWidth), 0, (newSize - oldSize) * stateWidth);
+        }
+        for (int p = 0; p < PlaneCount; p++) {
+            flagPlanes[p].resize(newSize);
+        }
+    } else {
+        // The row stride changes so every used row is copied across
+        QByteArray newStateData(newSize * stateWidth, 0);
+        QBitArray newFlagPlanes[PlaneCount];
+        for (int p = 0; p < PlaneCount; p++) {
+            newFlagPlanes[p].resize(newSize);
+        }
+
+        int copyRows = qMin(rowsUsed, rows);
+        int copyColumns = qMin(columnsUsed, columns);
+        for (int row = 0; row < copyRows; row++) {
+            int oldIndex = row * columnCapacity;
+            int newIndex = row * columns;
+            memcpy(newStateData.data() + (newIndex * stateWidth),
+                   stateData.constData() + (oldIndex * stateWidth),
+                   copyColumns * stateWidth);
+            for (int column = 0; column < copyColumns; column++) {
+                for (int p = 0; p < PlaneCount; p++) {
+                    newFlagPlanes[p].setBit(newIndex + column, flagPlanes[p].testBit(oldIndex + column));
+                }
+            }
+        }
+
+        stateData = newStateData;
+        for (int p = 0; p < PlaneCount; p++) {
+            flagPlanes[p] = newFlagPlanes[p];
+        }
+    }
+
+    rowCapacity = rows;
+    columnCapacity = columns;
+}
+
+// Re-pack every stored state set into a new byte width
+void MatrixGrid::setStateWidth(int width)
+{
+    QByteArray oldStateData = stateData;
+    int oldWidth = stateWidth;
+    int size = rowCapacity * columnCapacity;
+
+    stateWidth = width;
+    stateData = QByteArray(size * stateWidth, 0);
+
+    const uchar *oldData = reinterpret_cast<const uchar *>(oldStateData.constData());
+    for (int index = 0; index < size; index++) {
+        writeStateSet(index, loadStateSet(oldData + (index * oldWidth), oldWidth));
+    }
+}
+
+quint64 MatrixGrid::readStateSet(int index)
+{
+    return loadStateSet(reinterpret_cast<const uchar *>(stateData.constData()) + (index * stateWidth), stateWidth);
+}
+
+void MatrixGrid::writeStateSet(int index, quint64 stateSet)
+{
+    uchar *data = reinterpret_cast<uchar *>(stateData.data()) + (index * stateWidth);
+    switch (stateWidth) {
+    case 1:
+        *data = uchar(stateSet);
+        break;
+    case 2:
+        qToLittleEndian<quint16>(quint16(stateSet), data);
+        break;
+    case 4:
+        qToLittleEndian<quint32>(quint32(stateSet), data);
+        break;
+    default:
+        qToLittleEndian<quint64>(stateSet, data);
+        break;
+    }
+}
+
+int MatrixGrid::readFlags(int index)
+{
+    int flags = 0;
+    if (flagPlanes[MissingPlane].testBit(index)) flags |= MissingFlag;
+    if (flagPlanes[GapPlane].testBit(index)) flags |= GapFlag;
+    if (flagPlanes[PolymorphicPlane].testBit(index)) flags |= PolymorphicFlag;
+    if (flagPlanes[UncertainPlane].testBit(index)) flags |= UncertainFlag;
+    return flags;
+}
+
+void MatrixGrid::writeFlags(int index, int flags)
+{
+    flagPlanes[MissingPlane].setBit(index, flags & MissingFlag);
+    flagPlanes[GapPlane].setBit(index, flags & GapFlag);
+    flagPlanes[PolymorphicPlane].setBit(index, flags & PolymorphicFlag);
+    flagPlanes[UncertainPlane].setBit(index, flags & UncertainFlag);
+}
+
+void MatrixGrid::clearIndex(int index)
+{
+    writeStateSet(index, 0);
+    writeFlags(index, 0);
+}
@@ -0,0 +1,120 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef MATRIXGRID_H
+#define MATRIXGRID_H
+
+#include <QtGui>
+
+// Dense cell storage for a Matrix. Each cell's state set is held as a bitmask (one bit per symbol in
+// the grid's symbol alphabet) packed into 1, 2, 4 or 8 bytes depending on how many symbols are in use,
+// with separate one bit per cell planes for the missing, gap, polymorphic and uncertain flags. Cells
+// are laid out row-major, taxa are rows and characters are columns, and are addressed by taxon and
+// character ID through a slot table so that IDs never have to be contiguous. Cell notes are not held
+// here, see Matrix::cellNotes().
+class MatrixGrid
+{
+public:
+    MatrixGrid();
+
+    enum CellFlag {
+        MissingFlag = 0x1,
+        GapFlag = 0x2,
+        PolymorphicFlag = 0x4,
+        UncertainFlag = 0x8
+    };
+
+    static const int maxSymbols = 64;
+
+    void clear();
+    void reserve(int rows, int columns);
+    void swap(MatrixGrid &other);
+
+    void setMissingSymbol(QString symbol);
+    void setGapSymbol(QString symbol);
+    QString getSymbols();
+    int symbolIndex(QChar symbol);
+
+    bool setCell(int taxonID, int characterID, QString state);
+    void setCellData(int taxonID, int characterID, quint64 stateSet, int flags);
+    QVector<int> columnsFor(const QVector<int> &characterIDs);
+    void setRowData(int taxonID, const QVector<int> &columns, int first, int count, const quint64 *stateSets, const quint8 *flags);
+    void clearCell(int taxonID, int characterID);
+    void removeRow(int taxonID);
+    void removeColumn(int characterID);
+
+    bool hasCell(int taxonID, int characterID);
+    QString getState(int taxonID, int characterID);
+    quint64 getStateSet(int taxonID, int characterID);
+    int getFlags(int taxonID, int characterID);
+    bool isSymbolSelected(QString symbol, int taxonID, int characterID);
+
+    bool encodeState(QString state, quint64 &stateSet, int &flags);
+    QString decodeState(quint64 stateSet, int flags);
+
+    int rowCount();
+    int columnCount();
+    int cellCount();
+    int bytesPerCell();
+    qint64 memoryUsage();
+
+private:
+    enum FlagPlane {
+        MissingPlane = 0,
+        GapPlane,
+        PolymorphicPlane,
+        UncertainPlane,
+        PlaneCount
+    };
+
+    int stateWidth;
+    int rowCapacity;
+    int columnCapacity;
+    int rowsUsed;
+    int columnsUsed;
+
+    QByteArray stateData;
+    QBitArray flagPlanes[PlaneCount];
+
+    QHash<int, int> rowSlots;
+    QHash<int, int> columnSlots;
+    QList<int> freeRowSlots;
+    QList<int> freeColumnSlots;
+
+    QString symbols;
+    QList<int> symbolDecodeOrder;
+    qint8 asciiSymbolLookup[128];
+    QString missingSymbol;
+    QString gapSymbol;
+
+    int rowSlot(int taxonID);
+    int columnSlot(int characterID);
+    int addRowSlot(int taxonID);
+    int addColumnSlot(int characterID);
+    int cellIndex(int row, int column) { return (row * columnCapacity) + column; }
+
+    int addSymbol(QChar symbol);
+    void resizeStorage(int rows, int columns);
+    void setStateWidth(int width);
+    quint64 readStateSet(int index);
+    void writeStateSet(int index, quint64 stateSet);
+    int readFlags(int index);
+    void writeFlags(int index, int flags);
+    void clearIndex(int index);
+};
+
+#endif // MATRIXGRID_H
@@ -0,0 +1,460 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "matrixjournal.h"
+
+MatrixJournal::MatrixJournal()
+{
+    memoryLimit = Q_INT64_C(32) * 1024 * 1024;
+    nextGroup = 1;
+    currentGroup = 0;
+    clear();
+}
+
+void MatrixJournal::clear()
+{
+    entries.clear();
+    position = 0;
+    bytesUsed = 0;
+    droppedText.clear();
+}
+
+// Add an entry after the current position, anything that could have been redone is dropped
+void MatrixJournal::record(Entry entry)
+{
+    while (entries.count() > position) {
+        bytesUsed -= entries.last().bytes;
+        entries.removeLast();
+    }
+
+    entry.group = currentGroup;
+    if (currentGroup != 0) {
+        entry.text = currentGroupText;
+
+        // Fold cell edits into the group's previous cell edit entry
+        if (!entries.isEmpty() && entries.last().group == currentGroup && entries.last().type == CellEdit && entry.type == CellEdit) {
+            Entry &last = entries.last();
+            qint64 bytes = entrySize(entry) - (qint64)sizeof(Entry) - entry.text.capacity() * sizeof(QChar);
+            last.cells += entry.cells;
+            last.notes += entry.notes;
+            last.bytes += bytes;
+            bytesUsed += bytes;
+            trim();
+            return;
+        }
+    }
+
+    entry.bytes = entrySize(entry);
+    bytesUsed += entry.bytes;
+    entries.append(entry);
+    position = entries.count();
+
+    trim();
+}
+
+// Start a group, everything recorded until endGroup() is one undo step with the given text
+void MatrixJournal::beginGroup(QString text)
+{
+    currentGroup = nextGroup++;
+    currentGroupText = text;
+}
+
+// The group may have gone over the memory limit while it was open, it is trimmed as a whole now
+void MatrixJournal::endGroup()
+{
+    currentGroup = 0;
+    currentGroupText.clear();
+    trim();
+}
+
+bool MatrixJournal::canUndo()
+{
+    return (position > 0);
+}
+
+bool MatrixJournal::canRedo()
+{
+    return (position < entries.count());
+}
+
+QString MatrixJournal::undoText()
+{
+    return (canUndo() ? entries.at(position-1).text : QString());
+}
+
+QString MatrixJournal::redoText()
+{
+    return (canRedo() ? entries.at(position).text : QString());
+}
+
+MatrixJournal::Entry &MatrixJournal::undoEntry()
+{
+    return entries[position-1];
+}
+
+MatrixJournal::Entry &MatrixJournal::redoEntry()
+{
+    return entries[position];
+}
+
+void MatrixJournal::stepBack()
+{
+    if (position > 0) {
+        position--;
+    }
+}
+
+void MatrixJournal::stepForward()
+{
+    if (position < entries.count()) {
+        position++;
+    }
+}
+
+/*------------------------------------------------------------------------------------/
+ * Memory Functions
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixJournal::setMemoryLimit(qint64 bytes)
+{
+    memoryLimit = bytes;
+    trim();
+
+    // Only an edit that is being recorded is reported
+    droppedText.clear();
+}
+
+qint64 MatrixJournal::getMemoryLimit()
+{
+    return memoryLimit;
+}
+
+qint64 MatrixJournal::memoryUsage()
+{
+    return bytesUsed;
+}
+
+int MatrixJournal::count()
+{
+    return entries.count();
+}
+
+QString MatrixJournal::takeDroppedText()
+{
+    QString text = droppedText;
+    droppedText.clear();
+    return text;
+}
+
+// Drop the oldest entries until the journal fits its limit. An entry bigger than the limit on its own
+// is dropped as well, that edit simply cannot be undone. The group still being recorded is left alone
+// until endGroup(), so that it is never undone in part.
+void MatrixJournal::trim()
+{
+    while (bytesUsed > memoryLimit && !entries.isEmpty()) {
+        if (position > 0) {
+            int group = entries.first().group;
+            if (group != 0 && group == currentGroup) {
+                break;
+            }
+
+            // Never leave half a group behind
+            do {
+                if (position == 1) {
+                    droppedText = entries.first().text;
+                }
+                bytesUsed -= entries.first().bytes;
+                entries.removeFirst();
+                position--;
+            } while (group != 0 && position > 0 && entries.first().group == group);
+        } else {
+            // Everything left is redo history, the newest of it is the least likely to be wanted
+            bytesUsed -= entries.last().bytes;
+            entries.removeLast();
+        }
+    }
+}
+
+// Approximate bytes held by an entry
+qint64 MatrixJournal::entrySize(Entry &entry)
+{
+    qint64 bytes = sizeof(Entry) + entry.text.capacity() * sizeof(QChar);
+
+    bytes += entry.cells.capacity() * (qint64)sizeof(CellDelta);
+    for (int i = 0; i < entry.notes.count(); i++) {
+        bytes += sizeof(NoteDelta) + (entry.notes.at(i).oldNotes.capacity() + entry.notes.at(i).newNotes.capacity()) * sizeof(QChar);
+    }
+
+    bytes += (entry.oldLabel.capacity() + entry.newLabel.capacity() + entry.oldNotes.capacity() + entry.newNotes.capacity()) * sizeof(QChar);
+
+    for (int i = 0; i < entry.taxa.count(); i++) {
+        bytes += sizeof(Taxon) + (entry.taxa[i].getLabel().size() + entry.taxa[i].getNotes().size()) * sizeof(QChar);
+    }
+    for (int i = 0; i < entry.characters.count(); i++) {
+        bytes += sizeof(Character) + (entry.characters[i].getLabel().size() + entry.characters[i].getNotes().size()) * sizeof(QChar);
+        bytes += entry.characters[i].countStates() * (qint64)sizeof(State);
+    }
+
+    bytes += entry.crossIDs.capacity() * (qint64)sizeof(int);
+    bytes += entry.cellStates.capacity();
+    bytes += entry.cellFlags.capacity();
+
+    return bytes;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Packed Cell Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Start an entry's cells, stateWidth being the byte width of the grid they come from
+void MatrixJournal::reserveCells(Entry &entry, int stateWidth, int count)
+{
+    entry.stateWidth = stateWidth;
+    entry.cellStates.clear();
+    entry.cellStates.reserve(count * stateWidth);
+    entry.cellFlags.clear();
+    entry.cellFlags.reserve((count + 1) / 2);
+}
+
+void MatrixJournal::appendCell(Entry &entry, quint64 stateSet, int flags)
+{
+    int index = cellCount(entry);
+    int offset = entry.cellStates.size();
+    entry.cellStates.resize(offset + entry.stateWidth);
+    uchar *data = reinterpret_cast<uchar *>(entry.cellStates.data()) + offset;
+    switch (entry.stateWidth) {
+    case 1:
+        *data = uchar(stateSet);
+        break;
+    case 2:
+        qToLittleEndian<quint16>(quint16(stateSet), data);
+        break;
+    case 4:
+        qToLittleEndian<quint32>(quint32(stateSet), data);
+        break;
+    default:
+        qToLittleEndian<quint64>(stateSet, data);
+        break;
+    }
+
+    if (index % 2 == 0) {
+        entry.cellFlags.append((char)(flags & 0x0F));
+    } else {
+        entry.cellFlags[index / 2] = (char)(entry.cellFlags.at(index / 2) | ((flags & 0x0F) << 4));
+    }
+}
+
+int MatrixJournal::cellCount(Entry &entry)
+{
+    if (entry.cellStates.isEmpty()) {
+        return 0;
+    }
+    return entry.cellStates.size() / entry.stateWidth;
+}
+
+quint64 MatrixJournal::cellStateSet(Entry &entry, int index)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(entry.cellStates.constData()) + (index * entry.stateWidth);
+    switch (entry.stateWidth) {
+    case 1:
+        return *data;
+    case 2:
+        return qFromLittleEndian<quint16>(data);
+    case 4:
+        return qFromLittleEndian<quint32>(data);
+    default:
+        return qFromLittleEndian<quint64>(data);
+    }
+}
+
+int MatrixJournal::cellFlags(Entry &entry, int index)
+{
+    uchar flags = (uchar)entry.cellFlags.at(index / 2);
+    return (index % 2 == 0 ? (flags & 0x0F) : (flags >> 4));
+}
+
+// Move the state set bits of an entry read back from the autosave journal, bit i becoming symbolBits[i]. The
+// packed cells are repacked at full width, their new bits may not fit the width they were captured with.
+void MatrixJournal::remapStateSets(Entry &entry, const QVector<int> &symbolBits)
+{
+    for (int i = 0; i < entry.cells.count(); i++) {
+        entry.cells[i].oldStateSet = remapStateSet(entry.cells[i].oldStateSet, symbolBits);
+        entry.cells[i].newStateSet = remapStateSet(entry.cells[i].newStateSet, symbolBits);
+    }
+
+    Entry packed = entry;
+    int count = cellCount(packed);
+    reserveCells(entry, 8, count);
+    for (int i = 0; i < count; i++) {
+        appendCell(entry, remapStateSet(cellStateSet(packed, i), symbolBits), cellFlags(packed, i));
+    }
+}
+
+// A bit with no place in the grid (-1) is dropped
+quint64 MatrixJournal::remapStateSet(quint64 stateSet, const QVector<int> &symbolBits)
+{
+    quint64 remapped = 0;
+    for (int bit = 0; bit < symbolBits.count(); bit++) {
+        if ((stateSet & ((quint64)1 << bit)) && symbolBits.at(bit) != -1) {
+            remapped |= (quint64)1 << symbolBits.at(bit);
+        }
+    }
+    return remapped;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Serialisation, used by the autosave journal
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixJournal::writeEntry(QDataStream &out, Entry &entry)
+{
+    out << (qint32)entry.type << entry.text << (qint32)entry.group;
+
+    out << (qint32)entry.cells.count();
+    for (int i = 0; i < entry.cells.count(); i++) {
+        const CellDelta &delta = entry.cells.at(i);
+        out << (qint32)delta.taxonID << (qint32)delta.characterID << delta.oldStateSet << delta.newStateSet << delta.oldFlags << delta.newFlags;
+    }
+    out << (qint32)entry.notes.count();
+    for (int i = 0; i < entry.notes.count(); i++) {
+        const NoteDelta &delta = entry.notes.at(i);
+        out << (qint32)delta.taxonID << (qint32)delta.characterID << delta.oldNotes << delta.newNotes;
+    }
+
+    out << (qint32)entry.id << entry.oldLabel << entry.newLabel << entry.oldNotes << entry.newNotes;
+    out << entry.oldIsEnabled << entry.newIsEnabled << entry.oldIsOrdered << entry.newIsOrdered;
+    out << (qint32)entry.first << (qint32)entry.count << (qint32)entry.destination;
+
+    writeTaxa(out, entry.taxa);
+    writeCharacters(out, entry.characters);
+    out << entry.crossIDs << (qint32)(entry.cellStates.isEmpty() ? 0 : entry.stateWidth) << entry.cellStates << entry.cellFlags;
+}
+
+MatrixJournal::Entry MatrixJournal::readEntry(QDataStream &in)
+{
+    Entry entry;
+    qint32 type, group, count;
+    in >> type >> entry.text >> group;
+    entry.type = (EntryType)type;
+    entry.group = group;
+
+    in >> count;
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        CellDelta delta;
+        qint32 taxonID, characterID;
+        in >> taxonID >> characterID >> delta.oldStateSet >> delta.newStateSet >> delta.oldFlags >> delta.newFlags;
+        delta.taxonID = taxonID;
+        delta.characterID = characterID;
+        entry.cells.append(delta);
+    }
+    in >> count;
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        NoteDelta delta;
+        qint32 taxonID, characterID;
+        in >> taxonID >> characterID >> delta.oldNotes >> delta.newNotes;
+        delta.taxonID = taxonID;
+        delta.characterID = characterID;
+        entry.notes.append(delta);
+    }
+
+    qint32 id, first, destination;
+    in >> id >> entry.oldLabel >> entry.newLabel >> entry.oldNotes >> entry.newNotes;
+    in >> entry.oldIsEnabled >> entry.newIsEnabled >> entry.oldIsOrdered >> entry.newIsOrdered;
+    in >> first >> count >> destination;
+    entry.id = id;
+    entry.first = first;
+    entry.count = count;
+    entry.destination = destination;
+
+    entry.taxa = readTaxa(in);
+    entry.characters = readCharacters(in);
+    qint32 stateWidth;
+    in >> entry.crossIDs >> stateWidth >> entry.cellStates >> entry.cellFlags;
+    entry.stateWidth = stateWidth;
+    if (!entry.cellStates.isEmpty()) {
+        bool isWidth = (stateWidth == 1 || stateWidth == 2 || stateWidth == 4 || stateWidth == 8);
+        if (!isWidth || entry.cellStates.size() % stateWidth != 0 || entry.cellFlags.size() != (cellCount(entry) + 1) / 2) {
+            in.setStatus(QDataStream::ReadCorruptData);
+        }
+    }
+    entry.bytes = 0;
+    return entry;
+}
+
+void MatrixJournal::writeTaxa(QDataStream &out, QList<Taxon> &taxa)
+{
+    out << (qint32)taxa.count();
+    for (int i = 0; i < taxa.count(); i++) {
+        out << (qint32)taxa[i].getID() << taxa[i].getLabel() << taxa[i].getNotes() << taxa[i].getIsEnabled();
+    }
+}
+
+QList<Taxon> MatrixJournal::readTaxa(QDataStream &in)
+{
+    QList<Taxon> taxa;
+    qint32 count;
+    in >> count;
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        qint32 id;
+        QString label, notes;
+        bool isEnabled;
+        in >> id >> label >> notes >> isEnabled;
+        Taxon taxon(id, label, notes);
+        taxon.setIsEnabled(isEnabled);
+        taxa.append(taxon);
+    }
+    return taxa;
+}
+
+void MatrixJournal::writeCharacters(QDataStream &out, QList<Character> &characters)
+{
+    out << (qint32)characters.count();
+    for (int i = 0; i < characters.count(); i++) {
+        Character &character = characters[i];
+        out << (qint32)character.getID() << character.getLabel() << character.getNotes()
+            << character.getIsEnabled() << character.getIsEliminated() << character.getIsOrdered();
+        out << (qint32)character.countStates();
+        for (int s = 0; s < character.countStates(); s++) {
+            State state = character.getState(s);
+            out << state.getSymbol() << state.getLabel() << state.getNotes();
+        }
+    }
+}
+
+QList<Character> MatrixJournal::readCharacters(QDataStream &in)
+{
+    QList<Character> characters;
+    qint32 count;
+    in >> count;
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        qint32 id, states;
+        QString label, notes;
+        bool isEnabled, isEliminated, isOrdered;
+        in >> id >> label >> notes >> isEnabled >> isEliminated >> isOrdered >> states;
+        Character character(id, label, notes);
+        character.setIsEnabled(isEnabled);
+        character.setIsEliminated(isEliminated);
+        character.setIsOrdered(isOrdered);
+        for (int s = 0; s < states && in.status() == QDataStream::Ok; s++) {
+            QString symbol, name, stateNotes;
+            in >> symbol >> name >> stateNotes;
+            character.addState(symbol, name, stateNotes);
+        }
+        characters.append(character);
+    }
+    return characters;
+}
@@ -0,0 +1,161 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef MATRIXJOURNAL_H
+#define MATRIXJOURNAL_H
+
+#include <QtGui>
+
+#include "taxon.h"
+#include "character.h"
+
+// Undo/redo history of a Matrix. Each entry holds only what an edit changed: cell edits as old and new
+// state sets and flags, moves as index ranges, and inserted or removed taxa/characters as the items
+// themselves plus the packed cells of the rows or columns involved. The entries are applied by the
+// Matrix, the journal only keeps them in order and drops the oldest once the memory limit is passed.
+// Entries recorded between beginGroup() and endGroup() share a group number and are undone and redone
+// as one step, consecutive cell edits in a group are merged into a single entry.
+class MatrixJournal
+{
+public:
+    MatrixJournal();
+
+    enum EntryType {
+        CellEdit,
+        TaxonEdit,
+        CharacterEdit,
+        InsertTaxa,
+        RemoveTaxa,
+        MoveTaxa,
+        InsertCharacters,
+        RemoveCharacters,
+        MoveCharacters
+    };
+
+    struct CellDelta {
+        int taxonID;
+        int characterID;
+        quint64 oldStateSet;
+        quint64 newStateSet;
+        quint8 oldFlags;
+        quint8 newFlags;
+    };
+
+    struct NoteDelta {
+        int taxonID;
+        int characterID;
+        QString oldNotes;
+        QString newNotes;
+    };
+
+    struct Entry {
+        EntryType type;
+        QString text;
+        int group;
+
+        // CellEdit
+        QVector<CellDelta> cells;
+        QList<NoteDelta> notes;
+
+        // TaxonEdit/CharacterEdit, id is the taxon or character ID (isOrdered is only used by characters)
+        int id;
+        QString oldLabel;
+        QString newLabel;
+        QString oldNotes;
+        QString newNotes;
+        bool oldIsEnabled;
+        bool newIsEnabled;
+        bool oldIsOrdered;
+        bool newIsOrdered;
+
+        // Insert/Remove/Move, rows or columns first to first+count-1 (destination is only used by moves)
+        int first;
+        int count;
+        int destination;
+
+        // Insert/Remove, the items and their cells. crossIDs are the IDs along the other axis and the
+        // cells are packed item by item in crossIDs order: stateWidth bytes of state set per cell (the
+        // grid's width when they were captured) and the flags two cells a byte. notes holds the cells
+        // that had notes.
+        QList<Taxon> taxa;
+        QList<Character> characters;
+        QVector<int> crossIDs;
+        int stateWidth;
+        QByteArray cellStates;
+        QByteArray cellFlags;
+
+        qint64 bytes;
+    };
+
+    void clear();
+    void record(Entry entry);
+    void beginGroup(QString text);
+    void endGroup();
+
+    bool canUndo();
+    bool canRedo();
+    QString undoText();
+    QString redoText();
+
+    // The entry to apply, then step past it once it has been applied. Keep going while the next entry
+    // is in the same group as the one just applied.
+    Entry &undoEntry();
+    Entry &redoEntry();
+    void stepBack();
+    void stepForward();
+
+    // Text of the newest edit if it had to be dropped to stay within the memory limit, i.e. it cannot be
+    // undone. Reading it clears it.
+    QString takeDroppedText();
+
+    void setMemoryLimit(qint64 bytes);
+    qint64 getMemoryLimit();
+    qint64 memoryUsage();
+    int count();
+
+    // Packed cells of an Insert/Remove entry
+    static void reserveCells(Entry &entry, int stateWidth, int count);
+    static void appendCell(Entry &entry, quint64 stateSet, int flags);
+    static int cellCount(Entry &entry);
+    static quint64 cellStateSet(Entry &entry, int index);
+    static int cellFlags(Entry &entry, int index);
+    static void remapStateSets(Entry &entry, const QVector<int> &symbolBits);
+
+    // Entries and item lists as written to the autosave journal
+    static void writeEntry(QDataStream &out, Entry &entry);
+    static Entry readEntry(QDataStream &in);
+    static void writeTaxa(QDataStream &out, QList<Taxon> &taxa);
+    static QList<Taxon> readTaxa(QDataStream &in);
+    static void writeCharacters(QDataStream &out, QList<Character> &characters);
+    static QList<Character> readCharacters(QDataStream &in);
+
+private:
+    QList<Entry> entries;
+    int position;
+    int nextGroup;
+    int currentGroup;
+    QString currentGroupText;
+    qint64 bytesUsed;
+    qint64 memoryLimit;
+    QString droppedText;
+
+    qint64 entrySize(Entry &entry);
+    static quint64 remapStateSet(quint64 stateSet, const QVector<int> &symbolBits);
+    void trim();
+};
+
+#endif // MATRIXJOURNAL_H
@@ -0,0 +1,369 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "matrixtablemodel.h"
+#include "matrix.h"
+
+MatrixTableModel::MatrixTableModel(Matrix *parentMatrix, TableType type) :
+    QAbstractTableModel(parentMatrix)
+{
+    matrix = parentMatrix;
+    tableType = type;
+    isBatching = false;
+    isBatchReset = false;
+    updateCounts();
+}
+
+void MatrixTableModel::updateCounts()
+{
+    taxaNumber = matrix->taxaCount();
+    characterNumber = (tableType == TaxaTable ? 1 : matrix->charactersCount());
+}
+
+/*------------------------------------------------------------------------------------/
+ * Model Functions
+ *-----------------------------------------------------------------------------------*/
+
+int MatrixTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return taxaNumber;
+}
+
+int MatrixTableModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return characterNumber;
+}
+
+QVariant MatrixTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (tableType == TaxaTable) {
+        if (role == Qt::DisplayRole) {
+            return matrix->taxonList[index.row()].getLabel();
+        }
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole: {
+        QPair<int,int> locator = matrix->cellLocator(index.row(), index.column());
+        return matrix->cellState(locator.first, locator.second);
+    }
+    case CellFlagsRole: {
+        QPair<int,int> locator = matrix->cellLocator(index.row(), index.column());
+        return matrix->matrixGrid.getFlags(locator.first, locator.second);
+    }
+    case Qt::TextAlignmentRole:
+        return int(Qt::AlignHCenter|Qt::AlignVCenter);
+    case Qt::BackgroundRole:
+        if (matrix->currentSelectedCell.first == index.row() && matrix->currentSelectedCell.second == index.column()) {
+            return matrix->currentSelectedCellColor;
+        }
+        return QVariant();
+    }
+    return QVariant();
+}
+
+// Edits go through the Matrix so they are checked against the allowed symbols
+bool MatrixTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || tableType != DataTable || role != Qt::EditRole) {
+        return false;
+    }
+
+    bool isChanged = matrix->editCell(index.row(), index.column(), value.toString());
+
+    // Refresh either way, on an error the stored state is shown again
+    emit dataChanged(index, index);
+    return isChanged;
+}
+
+QVariant MatrixTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    if (orientation == Qt::Vertical) {
+        return tr("T%1").arg(section+1);
+    }
+    if (tableType == TaxaTable) {
+        return tr("Taxa");
+    }
+    return tr("C%1").arg(section+1);
+}
+
+Qt::ItemFlags MatrixTableModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    if (tableType == TaxaTable) {
+        return Qt::ItemIsEnabled;
+    }
+    return Qt::ItemIsEnabled|Qt::ItemIsEditable;
+}
+
+void MatrixTableModel::getCell(int row, int column, quint64 &stateSet, int &cellFlags) const
+{
+    QPair<int,int> locator = matrix->cellLocator(row, column);
+    stateSet = matrix->matrixGrid.getStateSet(locator.first, locator.second);
+    cellFlags = matrix->matrixGrid.getFlags(locator.first, locator.second);
+}
+
+bool MatrixTableModel::isSelectedCell(int row, int column) const
+{
+    return (matrix->currentSelectedCell.first == row && matrix->currentSelectedCell.second == column);
+}
+
+QBrush MatrixTableModel::selectedCellBrush() const
+{
+    return matrix->currentSelectedCellColor;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Notifier Functions
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixTableModel::beginResetMatrix()
+{
+    beginResetModel();
+}
+
+void MatrixTableModel::endResetMatrix()
+{
+    updateCounts();
+    endResetModel();
+}
+
+void MatrixTableModel::beginInsertTaxa(int first, int last)
+{
+    if (batchStructureChange()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), first, last);
+}
+
+void MatrixTableModel::endInsertTaxa()
+{
+    if (isBatching) {
+        return;
+    }
+    updateCounts();
+    endInsertRows();
+    emit headerDataChanged(Qt::Vertical, 0, taxaNumber-1);
+}
+
+void MatrixTableModel::beginRemoveTaxa(int first, int last)
+{
+    if (batchStructureChange()) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), first, last);
+}
+
+void MatrixTableModel::endRemoveTaxa()
+{
+    if (isBatching) {
+        return;
+    }
+    updateCounts();
+    endRemoveRows();
+    if (taxaNumber > 0) {
+        emit headerDataChanged(Qt::Vertical, 0, taxaNumber-1);
+    }
+}
+
+// Move rows first..last so that the first of them ends up at row destination
+void MatrixTableModel::beginMoveTaxa(int first, int last, int destination)
+{
+    if (batchStructureChange()) {
+        return;
+    }
+    int destinationChild = (destination > first ? destination + (last - first + 1) : destination);
+    beginMoveRows(QModelIndex(), first, last, QModelIndex(), destinationChild);
+}
+
+void MatrixTableModel::endMoveTaxa()
+{
+    if (isBatching) {
+        return;
+    }
+    endMoveRows();
+}
+
+void MatrixTableModel::beginInsertCharacters(int first, int last)
+{
+    if (tableType == DataTable && !batchStructureChange()) {
+        beginInsertColumns(QModelIndex(), first, last);
+    }
+}
+
+void MatrixTableModel::endInsertCharacters()
+{
+    if (tableType == DataTable && !isBatching) {
+        updateCounts();
+        endInsertColumns();
+        emit headerDataChanged(Qt::Horizontal, 0, characterNumber-1);
+    }
+}
+
+void MatrixTableModel::beginRemoveCharacters(int first, int last)
+{
+    if (tableType == DataTable && !batchStructureChange()) {
+        beginRemoveColumns(QModelIndex(), first, last);
+    }
+}
+
+void MatrixTableModel::endRemoveCharacters()
+{
+    if (tableType == DataTable && !isBatching) {
+        updateCounts();
+        endRemoveColumns();
+        if (characterNumber > 0) {
+            emit headerDataChanged(Qt::Horizontal, 0, characterNumber-1);
+        }
+    }
+}
+
+// Move columns first..last so that the first of them ends up at column destination
+void MatrixTableModel::beginMoveCharacters(int first, int last, int destination)
+{
+    if (tableType == DataTable && !batchStructureChange()) {
+        int destinationChild = (destination > first ? destination + (last - first + 1) : destination);
+        beginMoveColumns(QModelIndex(), first, last, QModelIndex(), destinationChild);
+    }
+}
+
+void MatrixTableModel::endMoveCharacters()
+{
+    if (tableType == DataTable && !isBatching) {
+        endMoveColumns();
+    }
+}
+
+void MatrixTableModel::cellChanged(int row, int column)
+{
+    if (tableType == DataTable && row >= 0 && row < taxaNumber && column >= 0 && column < characterNumber) {
+        if (isBatching) {
+            addBatchRange(row, column, row, column);
+            return;
+        }
+        emit dataChanged(index(row, column), index(row, column));
+    }
+}
+
+void MatrixTableModel::cellsChanged(int firstRow, int firstColumn, int lastRow, int lastColumn)
+{
+    if (tableType == DataTable && taxaNumber > 0 && characterNumber > 0) {
+        firstRow = qMax(firstRow, 0);
+        firstColumn = qMax(firstColumn, 0);
+        lastRow = qMin(lastRow, taxaNumber-1);
+        lastColumn = qMin(lastColumn, characterNumber-1);
+        if (firstRow <= lastRow && firstColumn <= lastColumn) {
+            if (isBatching) {
+                addBatchRange(firstRow, firstColumn, lastRow, lastColumn);
+                return;
+            }
+            emit dataChanged(index(firstRow, firstColumn), index(lastRow, lastColumn));
+        }
+    }
+}
+
+void MatrixTableModel::taxonChanged(int row)
+{
+    if (tableType == TaxaTable && row >= 0 && row < taxaNumber) {
+        if (isBatching) {
+            addBatchRange(row, 0, row, 0);
+            return;
+        }
+        emit dataChanged(index(row, 0), index(row, 0));
+    }
+}
+
+/*------------------------------------------------------------------------------------/
+ * Batch Functions
+ *-----------------------------------------------------------------------------------*/
+
+void MatrixTableModel::beginBatch()
+{
+    isBatching = true;
+    isBatchReset = false;
+    batchFirstRow = -1;
+    batchFirstColumn = -1;
+    batchLastRow = -1;
+    batchLastColumn = -1;
+}
+
+// Send the batch to the views, returns true if it was sent as a model reset
+bool MatrixTableModel::endBatch()
+{
+    isBatching = false;
+
+    if (isBatchReset) {
+        isBatchReset = false;
+        updateCounts();
+        endResetModel();
+        return true;
+    }
+
+    if (batchFirstRow != -1) {
+        emit dataChanged(index(batchFirstRow, batchFirstColumn), index(batchLastRow, batchLastColumn));
+    }
+    return false;
+}
+
+// Called by the begin notifiers, returns true if the change is covered by the batch's model reset
+bool MatrixTableModel::batchStructureChange()
+{
+    if (!isBatching) {
+        return false;
+    }
+    if (!isBatchReset) {
+        isBatchReset = true;
+        beginResetModel();
+    }
+    return true;
+}
+
+void MatrixTableModel::addBatchRange(int firstRow, int firstColumn, int lastRow, int lastColumn)
+{
+    if (isBatchReset) {
+        return;
+    }
+    if (batchFirstRow == -1) {
+        batchFirstRow = firstRow;
+        batchFirstColumn = firstColumn;
+        batchLastRow = lastRow;
+        batchLastColumn = lastColumn;
+    } else {
+        batchFirstRow = qMin(batchFirstRow, firstRow);
+        batchFirstColumn = qMin(batchFirstColumn, firstColumn);
+        batchLastRow = qMax(batchLastRow, lastRow);
+        batchLastColumn = qMax(batchLastColumn, lastColumn);
+    }
+}
@@ -0,0 +1,104 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef MATRIXTABLEMODEL_H
+#define MATRIXTABLEMODEL_H
+
+#include <QtGui>
+#include <QAbstractTableModel>
+
+class Matrix;
+
+// Table model for the two halves of the matrix table. The taxa table has one column of taxon labels, the
+// data table has one column per character. Nothing is copied out of the Matrix, cell text, alignment and
+// the selection colour are looked up when the view asks for them. Row and column counts are cached and
+// only refreshed by the begin/end notifiers, so the Matrix must bracket every structural change with them.
+// Between beginBatch() and endBatch() nothing is sent to the views straight away: the first structural
+// change turns the whole batch into one model reset, otherwise changed cells are collected into one range.
+class MatrixTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum TableType {
+        TaxaTable,
+        DataTable
+    };
+
+    // Extra role giving the MatrixGrid::CellFlag bits of a data cell
+    enum MatrixRole {
+        CellFlagsRole = Qt::UserRole + 1
+    };
+
+    MatrixTableModel(Matrix *parentMatrix, TableType type);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+
+    // Data table lookups for the cell delegate, so that painting a cell does not go through QVariant
+    void getCell(int row, int column, quint64 &stateSet, int &cellFlags) const;
+    bool isSelectedCell(int row, int column) const;
+    QBrush selectedCellBrush() const;
+
+    //-- Notifiers:
+    void beginResetMatrix();
+    void endResetMatrix();
+
+    void beginInsertTaxa(int first, int last);
+    void endInsertTaxa();
+    void beginRemoveTaxa(int first, int last);
+    void endRemoveTaxa();
+    void beginMoveTaxa(int first, int last, int destination);
+    void endMoveTaxa();
+
+    void beginInsertCharacters(int first, int last);
+    void endInsertCharacters();
+    void beginRemoveCharacters(int first, int last);
+    void endRemoveCharacters();
+    void beginMoveCharacters(int first, int last, int destination);
+    void endMoveCharacters();
+
+    void cellChanged(int row, int column);
+    void cellsChanged(int firstRow, int firstColumn, int lastRow, int lastColumn);
+    void taxonChanged(int row);
+
+    void beginBatch();
+    bool endBatch();
+
+private:
+    Matrix *matrix;
+    TableType tableType;
+    int taxaNumber;
+    int characterNumber;
+
+    bool isBatching;
+    bool isBatchReset;
+    int batchFirstRow;
+    int batchFirstColumn;
+    int batchLastRow;
+    int batchLastColumn;
+
+    void updateCounts();
+    bool batchStructureChange();
+    void addBatchRange(int firstRow, int firstColumn, int lastRow, int lastColumn);
+};
+
+#endif // MATRIXTABLEMODEL_H
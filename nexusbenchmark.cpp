@@ -0,0 +1,237 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "nexusbenchmark.h"
+#include "mainwindow.h"
+
+NexusBenchmark::NexusBenchmark(MainWindow *mw, Settings *s)
+{
+    mainwindow = mw;
+    settings = s;
+}
+
+// The benchmark cases, each one picks out a different path through the reader
+QList<NexusGenerator> NexusBenchmark::cases()
+{
+    QList<NexusGenerator> list;
+    NexusGenerator generator;
+
+    // Plain sequence rows, the bulk run reader
+    generator.datatype = "DNA";
+    generator.ntax = 500;
+    generator.nchar = 10000;
+    list.append(generator);
+
+    generator.interleaveWidth = 100;
+    list.append(generator);
+    generator.interleaveWidth = 0;
+
+    // Runs broken up by state sets, equates go through the compiled state codes
+    generator.polymorphismRate = 0.01;
+    generator.equateRate = 0.05;
+    list.append(generator);
+    generator.polymorphismRate = 0.0;
+    generator.equateRate = 0.0;
+
+    generator.transposed = true;
+    list.append(generator);
+    generator.transposed = false;
+
+    generator.datatype = "PROTEIN";
+    list.append(generator);
+
+    // Standard data is read a state at a time
+    generator.datatype = "STANDARD";
+    generator.ntax = 2000;
+    generator.nchar = 500;
+    generator.polymorphismRate = 0.05;
+    generator.equateRate = 0.05;
+    list.append(generator);
+
+    // Many short rows with long labels, the taxon lookup and per row overhead
+    generator.datatype = "DNA";
+    generator.ntax = 20000;
+    generator.nchar = 200;
+    generator.polymorphismRate = 0.0;
+    generator.equateRate = 0.0;
+    generator.labelLength = 64;
+    list.append(generator);
+
+    for (int i = 0; i < list.count(); i++) {
+        list[i].seed = i + 1;
+    }
+    return list;
+}
+
+// Run every case, progress may be 0 when there is no window to show it in
+QList<NexusBenchmark::Result> NexusBenchmark::run(QProgressDialog *progress)
+{
+    QList<Result> results;
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        return results;
+    }
+
+    QList<NexusGenerator> list = cases();
+    if (progress) {
+        progress->setRange(0, list.count());
+    }
+    for (int i = 0; i < list.count() && !(progress && progress->wasCanceled()); i++) {
+        Result result;
+        result.name = list[i].describe();
+        if (progress) {
+            progress->setLabelText(QObject::tr("Benchmarking %1...").arg(result.name));
+            progress->setValue(i);
+            QApplication::processEvents();
+        }
+
+        QString fileName = dir.path() + QString("/case%1.nex").arg(i + 1);
+        if (!list[i].write(fileName)) {
+            continue;
+        }
+        result.fileSize = QFileInfo(fileName).size();
+        result.cells = list[i].countCells();
+
+        result.tokenizeNs = tokenize(fileName);
+
+        bool hasPeak = resetPeakMemory();
+        result.importNs = import(fileName, result.isImported);
+        result.peakMemory = (hasPeak ? peakMemory() : -1);
+
+        results.append(result);
+        QFile::remove(fileName);
+    }
+    if (progress) {
+        progress->setValue(list.count());
+    }
+    return results;
+}
+
+// One line per case, the format is kept stable so results can be compared with a diff
+QString NexusBenchmark::formatResult(Result &result)
+{
+    double megabytes = (double)result.fileSize / (1024.0 * 1024.0);
+    double tokenizeSeconds = qMax(result.tokenizeNs, Q_INT64_C(1)) / 1.0e9;
+    double importSeconds = qMax(result.importNs, Q_INT64_C(1)) / 1.0e9;
+
+    QString text = QString("%1: %2 MB, tokenize %3 MB/s, import %4 MB/s %5 Mcells/s")
+            .arg(result.name)
+            .arg(megabytes, 0, 'f', 1)
+            .arg(megabytes / tokenizeSeconds, 0, 'f', 1)
+            .arg(megabytes / importSeconds, 0, 'f', 1)
+            .arg(result.cells / importSeconds / 1.0e6, 0, 'f', 2);
+    if (result.peakMemory >= 0) {
+        text += QString(", peak %1 MB").arg(result.peakMemory / (1024 * 1024));
+    }
+    if (!result.isImported) {
+        text += " (import FAILED)";
+    }
+    return text;
+}
+
+// Read back the case name and rates from a line written by formatResult(), returns false if it is not one
+bool NexusBenchmark::parseResult(QString line, QString &name, double &tokenizeRate, double &importRate)
+{
+    QRegularExpression pattern("^(.+): [0-9.]+ MB, tokenize ([0-9.]+) MB/s, import ([0-9.]+) MB/s");
+    QRegularExpressionMatch match = pattern.match(line.trimmed());
+    if (!match.hasMatch()) {
+        return false;
+    }
+    name = match.captured(1);
+    tokenizeRate = match.captured(2).toDouble();
+    importRate = match.captured(3).toDouble();
+    return true;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Timed Runs
+ *-----------------------------------------------------------------------------------*/
+
+// Time to split the whole file into tokens, in nanoseconds
+qint64 NexusBenchmark::tokenize(QString fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    NexusParserToken token(file);
+    for (;;) {
+        token.getNextToken();
+        if (token.getAtEndOfFile()) {
+            break;
+        }
+    }
+    return timer.nsecsElapsed();
+}
+
+// Time for a full read of the TAXA and CHARACTERS blocks, in nanoseconds
+qint64 NexusBenchmark::import(QString fileName, bool &isImported)
+{
+    isImported = false;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    NexusParserToken token(file);
+    NexusParserReader *reader = new NexusParserReader(mainwindow, settings);
+    reader->addBlock("TAXA");
+    reader->addBlock("ASSUMPTIONS");
+    reader->addBlock("CHARACTERS");
+    isImported = reader->execute(token);
+    qint64 elapsed = timer.nsecsElapsed();
+
+    delete reader;
+    return elapsed;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Memory
+ *-----------------------------------------------------------------------------------*/
+
+// Restart the process's peak resident set size from its current size. Only Linux allows this, elsewhere false is
+// returned and no peak is reported.
+bool NexusBenchmark::resetPeakMemory()
+{
+    QFile file("/proc/self/clear_refs");
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    return (file.write("5") == 1);
+}
+
+// Peak resident set size since the last reset, in bytes
+qint64 NexusBenchmark::peakMemory()
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    QList<QByteArray> lines = file.readAll().split('\n');
+    for (int i = 0; i < lines.count(); i++) {
+        if (lines.at(i).startsWith("VmHWM:")) {
+            return lines.at(i).mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+        }
+    }
+    return -1;
+}
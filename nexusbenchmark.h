@@ -0,0 +1,63 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef NEXUSBENCHMARK_H
+#define NEXUSBENCHMARK_H
+
+#include <QtWidgets>
+
+#include "nexusgenerator.h"
+
+class MainWindow;
+class Settings;
+
+// Times the NEXUS reader on a fixed set of generated files. Each case is read twice, once by the tokenizer alone
+// and once as a full import through NexusParserReader, and reported as MB/s, cells/s and peak memory. The cases
+// and their seeds never change, so figures from different builds on the same machine can be compared directly.
+// Runs from Help > Benchmark NEXUS Reader, or without a window from benchmark/nexusbenchmark.pro, which can
+// check a run against an earlier one.
+class NexusBenchmark
+{
+public:
+    NexusBenchmark(MainWindow *mw, Settings *s);
+
+    struct Result {
+        QString name;
+        qint64 fileSize;
+        qint64 cells;
+        qint64 tokenizeNs;
+        qint64 importNs;
+        qint64 peakMemory;      // bytes, -1 where the platform does not report it
+        bool isImported;
+    };
+
+    QList<NexusGenerator> cases();
+    QList<Result> run(QProgressDialog *progress);
+    QString formatResult(Result &result);
+    static bool parseResult(QString line, QString &name, double &tokenizeRate, double &importRate);
+
+private:
+    MainWindow *mainwindow;
+    Settings *settings;
+
+    qint64 tokenize(QString fileName);
+    qint64 import(QString fileName, bool &isImported);
+    bool resetPeakMemory();
+    qint64 peakMemory();
+};
+
+#endif // NEXUSBENCHMARK_H
@@ -0,0 +1,182 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "nexusgenerator.h"
+
+NexusGenerator::NexusGenerator()
+{
+    ntax = 100;
+    nchar = 1000;
+    datatype = "DNA";
+    interleaveWidth = 0;
+    polymorphismRate = 0.0;
+    equateRate = 0.0;
+    labelLength = 10;
+    transposed = false;
+    seed = Q_UINT64_C(1);
+    randomState = seed;
+}
+
+qint64 NexusGenerator::countCells()
+{
+    return (qint64)ntax * nchar;
+}
+
+// One line summary of the options, used to name benchmark cases
+QString NexusGenerator::describe()
+{
+    QString text = QString("%1 %2x%3").arg(datatype).arg(ntax).arg(nchar);
+    if (transposed) {
+        text += " transposed";
+    }
+    if (interleaveWidth > 0) {
+        text += QString(" interleave %1").arg(interleaveWidth);
+    }
+    if (polymorphismRate > 0.0) {
+        text += QString(" poly %1%").arg(polymorphismRate * 100.0);
+    }
+    if (equateRate > 0.0) {
+        text += QString(" equates %1%").arg(equateRate * 100.0);
+    }
+    text += QString(" labels %1").arg(labelLength);
+    return text;
+}
+
+/*------------------------------------------------------------------------------------/
+ * Random Numbers
+ *-----------------------------------------------------------------------------------*/
+
+// xorshift64*, small and the same on every platform, unlike qrand()
+quint64 NexusGenerator::nextRandom()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * Q_UINT64_C(2685821657736338717);
+}
+
+double NexusGenerator::nextUniform()
+{
+    return (double)(nextRandom() >> 11) / (double)(Q_UINT64_C(1) << 53);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Writing
+ *-----------------------------------------------------------------------------------*/
+
+void NexusGenerator::setupDatatype()
+{
+    equatesFormat.clear();
+    if (datatype == "STANDARD") {
+        symbols = "0123";
+        equateSymbols = "XY";
+        equatesFormat = " SYMBOLS=\"0123\" EQUATE=\"X=(01) Y={23}\"";
+    } else if (datatype == "PROTEIN") {
+        symbols = "ACDEFGHIKLMNPQRSTVWY";
+        equateSymbols = "BZ";
+    } else {
+        datatype = "DNA";
+        symbols = "ACGT";
+        equateSymbols = "RYKMSWN";
+    }
+}
+
+// Labels are unique, the taxon number padded out with letters to labelLength
+QByteArray NexusGenerator::taxonLabel(int taxon)
+{
+    QByteArray label = "t" + QByteArray::number(taxon + 1);
+    while (label.size() < labelLength) {
+        label.append('a' + (label.size() % 26));
+    }
+    return label;
+}
+
+void NexusGenerator::appendCell(QByteArray &line)
+{
+    double roll = nextUniform();
+    if (roll < polymorphismRate) {
+        int first = nextRandom() % symbols.size();
+        int second = (first + 1 + (nextRandom() % (symbols.size() - 1))) % symbols.size();
+        line.append('(');
+        line.append(symbols.at(first));
+        line.append(symbols.at(second));
+        line.append(')');
+    } else if (roll < polymorphismRate + equateRate) {
+        line.append(equateSymbols.at(nextRandom() % equateSymbols.size()));
+    } else {
+        line.append(symbols.at(nextRandom() % symbols.size()));
+    }
+}
+
+bool NexusGenerator::write(QString fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    randomState = (seed != 0 ? seed : Q_UINT64_C(1));
+    setupDatatype();
+
+    int labelWidth = 0;
+    QList<QByteArray> labels;
+    for (int t = 0; t < ntax; t++) {
+        labels.append(taxonLabel(t));
+        labelWidth = qMax(labelWidth, labels.last().size());
+    }
+
+    QByteArray text = "#NEXUS\n\nBEGIN TAXA;\n    DIMENSIONS NTAX=" + QByteArray::number(ntax) + ";\n    TAXLABELS";
+    for (int t = 0; t < ntax; t++) {
+        text += "\n        " + labels.at(t);
+    }
+    text += "\n    ;\nEND;\n\nBEGIN CHARACTERS;\n    DIMENSIONS NCHAR=" + QByteArray::number(nchar) + ";\n";
+    text += "    FORMAT DATATYPE=" + datatype.toLatin1() + " MISSING=? GAP=-" + equatesFormat;
+    if (transposed) {
+        text += " TRANSPOSE";
+    }
+    if (interleaveWidth > 0) {
+        text += " INTERLEAVE";
+    }
+    text += ";\n    MATRIX\n";
+    file.write(text);
+
+    // Rows run along the taxa, or along the characters when transposed
+    int rows = (transposed ? nchar : ntax);
+    int columns = (transposed ? ntax : nchar);
+    int pageWidth = (interleaveWidth > 0 ? interleaveWidth : columns);
+
+    QByteArray line;
+    for (int page = 0; page < columns; page += pageWidth) {
+        int pageEnd = qMin(columns, page + pageWidth);
+        for (int r = 0; r < rows; r++) {
+            line = (transposed ? "c" + QByteArray::number(r + 1) : labels.at(r));
+            line = line.leftJustified(labelWidth + 2, ' ');
+            for (int c = page; c < pageEnd; c++) {
+                appendCell(line);
+            }
+            line.append('\n');
+            file.write(line);
+        }
+        if (pageEnd < columns) {
+            file.write("\n");
+        }
+    }
+
+    file.write("    ;\nEND;\n");
+    file.close();
+    return (file.error() == QFile::NoError);
+}
@@ -0,0 +1,58 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef NEXUSGENERATOR_H
+#define NEXUSGENERATOR_H
+
+#include <QtCore>
+
+// Writes synthetic NEXUS files with a TAXA and a CHARACTERS block, for timing the NEXUS reader. The output
+// depends only on the options and the seed, so the same options always give the same file.
+class NexusGenerator
+{
+public:
+    NexusGenerator();
+
+    int ntax;
+    int nchar;
+    QString datatype;           // STANDARD, DNA or PROTEIN
+    int interleaveWidth;        // characters (taxa if transposed) per interleave page, 0 for none
+    double polymorphismRate;    // share of cells written as a polymorphic state set
+    double equateRate;          // share of cells written with an equate symbol
+    int labelLength;            // characters in each taxon label
+    bool transposed;            // one row per character rather than per taxon
+    quint64 seed;
+
+    bool write(QString fileName);
+    qint64 countCells();
+    QString describe();
+
+private:
+    quint64 randomState;
+    quint64 nextRandom();
+    double nextUniform();
+
+    QByteArray symbols;
+    QByteArray equateSymbols;
+    QByteArray equatesFormat;
+
+    void setupDatatype();
+    QByteArray taxonLabel(int taxon);
+    void appendCell(QByteArray &line);
+};
+
+#endif // NEXUSGENERATOR_H
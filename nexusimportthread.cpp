@@ -0,0 +1,102 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#include "nexusimportthread.h"
+
+NexusImportThread::NexusImportThread(MainWindow *mw, Settings *s, QString name, QObject *parent) :
+    QThread(parent)
+{
+    mainwindow = mw;
+    settings = s;
+    fileName = name;
+    reader = 0;
+    token = 0;
+    isExecuted = false;
+}
+
+NexusImportThread::~NexusImportThread()
+{
+    wait();
+    delete token;
+    delete reader;
+    file.close();
+}
+
+// Open the file and set up the token and reader, returns false if the file cannot be read
+bool NexusImportThread::open()
+{
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    token = new NexusParserToken(file);
+    reader = new NexusParserReader(mainwindow, settings);
+    reader->setProgress(&progress);
+    return true;
+}
+
+// Ask the reader to stop, it does so at the next row or block
+void NexusImportThread::cancel()
+{
+    progress.isCancelRequested.store(1);
+}
+
+void NexusImportThread::run()
+{
+    isExecuted = reader->execute(*token);
+    progress.bytesRead.store(token->getFilePosition());
+}
+
+/*------------------------------------------------------------------------------------/
+ * Return Functions
+ *-----------------------------------------------------------------------------------*/
+
+QString NexusImportThread::getFileName()
+{
+    return fileName;
+}
+
+qint64 NexusImportThread::getFileSize()
+{
+    return (token ? token->getFileSize() : 0);
+}
+
+qint64 NexusImportThread::getBytesRead()
+{
+    return progress.bytesRead.load();
+}
+
+int NexusImportThread::getRowsRead()
+{
+    return progress.rowsRead.load();
+}
+
+bool NexusImportThread::getIsExecuted()
+{
+    return isExecuted;
+}
+
+bool NexusImportThread::getIsCancelled()
+{
+    return (progress.isCancelRequested.load() != 0);
+}
+
+NexusParserReader *NexusImportThread::getReader()
+{
+    return reader;
+}
@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------------------------------------------
+ * Matrix Data Editor (MaDE)
+ *
+ * Copyright (c) 2012-2013, Alan R.T. Spencer
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation; either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If not,
+ * see http://www.gnu.org/licenses/.
+ *-----------------------------------------------------------------------------------------------------*/
+
+#ifndef NEXUSIMPORTTHREAD_H
+#define NEXUSIMPORTTHREAD_H
+
+#include <QtWidgets>
+
+#include "nexusparser.h"
+
+class MainWindow;
+class Settings;
+
+// Runs a NexusParserReader over a NEXUS file on its own thread. The file, token and reader are set up on the GUI
+// thread by open(), only execute() runs on the import thread. Progress is published through a NexusParserProgress
+// that the GUI polls without locking, and cancel() asks the reader to stop at the next row or block. Once finished()
+// has been emitted the parsed blocks can be taken from getReader() on the GUI thread.
+class NexusImportThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    NexusImportThread(MainWindow *mw, Settings *s, QString name, QObject *parent = 0);
+    ~NexusImportThread();
+
+    bool open();
+    void cancel();
+
+    QString getFileName();
+    qint64 getFileSize();
+    qint64 getBytesRead();
+    int getRowsRead();
+    bool getIsExecuted();
+    bool getIsCancelled();
+    NexusParserReader *getReader();
+
+protected:
+    void run();
+
+private:
+    MainWindow *mainwindow;
+    Settings *settings;
+    QString fileName;
+    QFile file;
+
+    NexusParserReader *reader;
+    NexusParserToken *token;
+    NexusParserProgress progress;
+
+    bool isExecuted;
+};
+
+#endif // NEXUSIMPORTTHREAD_H
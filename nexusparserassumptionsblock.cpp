@@ -66,62 +66,68 @@ void NexusParserAssumptionsBlock::read(NexusParserToken &token)
     for(;;)
     {
         token.getNextToken();
-        NexusParserBlock::NexusParserCommandResult result = handleBasicBlockCommands(token);
-        if (result == NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK)){
-            return;
-        }
-        if (result != NexusParserBlock::NexusParserCommandResult(HANDLED_COMMAND)){
-            if (token.equals("OPTIONS")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"OPTIONS\" on line %1.").arg(token.getFileLine()));
-                handleOptions(token);
-            } else if (token.equals("EXSET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"EXSET\" on line %1.").arg(token.getFileLine()));
-                handleExSet(token);
-            } else if (token.equals("TAXSET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TAXSET\" on line %1.").arg(token.getFileLine()));
-                handleTaxSet(token);
-            } else if (token.equals("CHARPARTITION")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CHARPARTITION\" on line %1.").arg(token.getFileLine()));
-                handleCharPartition(token);
-            } else if (token.equals("CHARSET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CHARSET\" on line %1.").arg(token.getFileLine()));
-                handleCharSet(token);
-            } else if (token.equals("CODESET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CODESET\" on line %1.").arg(token.getFileLine()));
-                handleCodeSet(token);
-            } else if (token.equals("CODONPOSSET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CODONPOSSET\" on line %1.").arg(token.getFileLine()));
-                handleCodonPosSet(token);
-            } else if (token.equals("TAXPARTITION")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TAXPARTITION\" on line %1.").arg(token.getFileLine()));
-                handleTaxPartition(token);
-            } else if (token.equals("TREESET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TREESET\" on line %1.").arg(token.getFileLine()));
-                handleTreeSet(token);
-            } else if (token.equals("TREEPARTITION")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TREEPARTITION\" on line %1.").arg(token.getFileLine()));
-                handleTreePartition(token);
-            } else if (token.equals("TYPESET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TYPESET\" on line %1.").arg(token.getFileLine()));
-                handleTypeSet(token);
-            } else if (token.equals("USERTYPE")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"USERTYPE\" on line %1.").arg(token.getFileLine()));
-                handleUserType(token);
-            } else if (token.equals("WTSET")) {
-                nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"WTSET\" on line %1.").arg(token.getFileLine()));
-                handleWeightSet(token);
-            } else {
-                skippingCommand(token.getToken());
-
-                do {
-                    token.getNextToken();
-                } while(!token.getAtEndOfFile() && !token.equals(";"));
-
-                if (token.getAtEndOfFile()){
-                    errorMessage = "Unexpected end of file encountered";
-                    throw NexusParserException(errorMessage, token);
+        try {
+            NexusParserBlock::NexusParserCommandResult result = handleBasicBlockCommands(token);
+            if (result == NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK)){
+                return;
+            }
+            if (result != NexusParserBlock::NexusParserCommandResult(HANDLED_COMMAND)){
+                if (token.equals("OPTIONS")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"OPTIONS\" on line %1.").arg(token.getFileLine()));
+                    handleOptions(token);
+                } else if (token.equals("EXSET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"EXSET\" on line %1.").arg(token.getFileLine()));
+                    handleExSet(token);
+                } else if (token.equals("TAXSET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TAXSET\" on line %1.").arg(token.getFileLine()));
+                    handleTaxSet(token);
+                } else if (token.equals("CHARPARTITION")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CHARPARTITION\" on line %1.").arg(token.getFileLine()));
+                    handleCharPartition(token);
+                } else if (token.equals("CHARSET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CHARSET\" on line %1.").arg(token.getFileLine()));
+                    handleCharSet(token);
+                } else if (token.equals("CODESET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CODESET\" on line %1.").arg(token.getFileLine()));
+                    handleCodeSet(token);
+                } else if (token.equals("CODONPOSSET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"CODONPOSSET\" on line %1.").arg(token.getFileLine()));
+                    handleCodonPosSet(token);
+                } else if (token.equals("TAXPARTITION")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TAXPARTITION\" on line %1.").arg(token.getFileLine()));
+                    handleTaxPartition(token);
+                } else if (token.equals("TREESET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TREESET\" on line %1.").arg(token.getFileLine()));
+                    handleTreeSet(token);
+                } else if (token.equals("TREEPARTITION")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TREEPARTITION\" on line %1.").arg(token.getFileLine()));
+                    handleTreePartition(token);
+                } else if (token.equals("TYPESET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"TYPESET\" on line %1.").arg(token.getFileLine()));
+                    handleTypeSet(token);
+                } else if (token.equals("USERTYPE")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"USERTYPE\" on line %1.").arg(token.getFileLine()));
+                    handleUserType(token);
+                } else if (token.equals("WTSET")) {
+                    nexusParser->logMesssage(QString("ASSUMPTIONS Block: found command \"WTSET\" on line %1.").arg(token.getFileLine()));
+                    handleWeightSet(token);
+                } else {
+                    skippingCommand(token.getToken());
+
+                    do {
+                        token.getNextToken();
+                    } while(!token.getAtEndOfFile() && !token.equals(";"));
+
+                    if (token.getAtEndOfFile()){
+                        errorMessage = "Unexpected end of file encountered";
+                        throw NexusParserException(errorMessage, token);
+                    }
                 }
             }
+        } catch (NexusParserException &x) {
+            if (recoverAtCommandEnd(token, x) == NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK)) {
+                return;
+            }
         }
     }
 }
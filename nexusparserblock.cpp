@@ -118,6 +118,30 @@ void NexusParserBlock::handleEndblock(NexusParserToken &token)
     demandEndSemicolon(token, "END or ENDBLOCK");
 }
 
+// Called from the read() loops when a command has thrown. Outside validation mode the exception is passed on and
+// ends the read. In validation mode it is logged and the rest of the command is stepped over so that reading carries
+// on with the next one; if the block ends before a semicolon is found the block is finished here instead.
+NexusParserBlock::NexusParserCommandResult NexusParserBlock::recoverAtCommandEnd(NexusParserToken &token, NexusParserException &x)
+{
+    if (!nexusParser->isValidating() || nexusParser->isCancelled() || token.getAtEndOfFile()) {
+        throw x;
+    }
+    nexusParser->logError(x.msg, x.filePos, x.fileLine, x.fileCol);
+    errorMessage.clear();
+
+    while (!token.equals(";")) {
+        if (token.equals("END") || token.equals("ENDBLOCK")) {
+            handleEndblock(token);
+            return NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK);
+        }
+        token.getNextToken();
+        if (token.getAtEndOfFile()) {
+            throw NexusParserException("Unexpected end of file encountered", token.getFilePosition(), token.getFileLine(), token.getFileColumn());
+        }
+    }
+    return NexusParserBlock::NexusParserCommandResult(HANDLED_COMMAND);
+}
+
 // throws a NexusParserException with the token info for `token`
 // `expected` should fill in the phrase "Expecting ${expected}, but found..."
 // expected can be NULL. Sets this->errorMessage
@@ -83,6 +83,7 @@ public:
 
 protected:
     NexusParserCommandResult	handleBasicBlockCommands(NexusParserToken &token);
+    NexusParserCommandResult	recoverAtCommandEnd(NexusParserToken &token, NexusParserException &x);
     void generateUnexpectedTokenException(NexusParserToken &token, QString expected = NULL);
 
     void demandEquals(NexusParserToken &token, QString contextString);
@@ -42,6 +42,8 @@
 
 #include <QtWidgets>
 
+#include "matrixgrid.h"
+
 class NexusParserReader;
 class NexusParserToken;
 class NexusParserBlock;
@@ -50,7 +52,6 @@ class NexusParserTaxaBlock;
 class NexusParserAssumptionsBlock;
 class Character;
 class Equate;
-class Cell;
 //class NexusParserAssumptionsBlock;
 
 class NexusParserCharactersBlock : public NexusParserBlock
@@ -87,6 +88,14 @@ public:
     int getCharPos(int origCharIndex);
     virtual void reset();
 
+    NexusParserTaxaBlock *getTaxaBlock();
+    int     getDatatype();
+    QChar   getMissingSymbol();
+    QChar   getGapSymbol();
+    void    takeCharacters(QList<Character> &list);
+    void    takeEquates(QList<Equate> &list);
+    void    takeCells(MatrixGrid &grid, QHash<QPair<int, int>, QString> &notes);
+
 protected:
     virtual void read(NexusParserToken &token);
 
@@ -101,8 +110,17 @@ protected:
     void    handleStandardMatrix(NexusParserToken &token);
     void    handleTransposedMatrix(NexusParserToken &token);
     bool    handleNextState(NexusParserToken &token, int currentTaxon, int currentCharacter);
+    int     readStateRun(NexusParserToken &token, int currentTaxon, int currentCharacter, int lastCharacter);
+    bool    recoverAtRowEnd(NexusParserToken &token, NexusParserException &x);
+    int     decodeStateRun(NexusParserToken &token, int maxCount, quint64 *stateSets, quint8 *flags);
+    void    writeTransposedTile(const QVector<int> &taxonIDs, int firstTaxon, int lastTaxon, int firstCharacter, int count,
+                                const QVector<quint64> &tileStateSets, const QByteArray &tileFlags);
+    void    prepareMatrixGrid();
+    void    compileStateCodes();
+    bool    resolveStateCode(QString state, int &code, quint64 &stateSet);
 
     bool    isInSymbols(QChar ch);
+    QChar   symbolFor(QChar ch);
     void    resetSymbols();
     void    buildCharPosArray(bool checkEliminated = false);
 
@@ -126,7 +144,8 @@ protected:
     QChar   matchchar;                          // match symbol to use in matrix
     QList<QChar> symbols;                       // list of valid character state symbols
 
-    QHash<QPair<int, int>, Cell*> matrixGrid;   // stores the matrix data
+    MatrixGrid matrixGrid;                      // stores the matrix data, as encoded state sets and flags
+    QHash<QPair<int, int>, QString> cellNotes;  // notes of the cells that have any
     bool cellAdd(                               // add a new cell to the matrix data
             int taxonID,
             int characterID,
@@ -159,6 +178,19 @@ protected:
 
     QStringList items;                          // list of items
 
+    enum { invalidCode = -1, matchcharCode = 0x100 };   // stateCodes values that are not grid flags
+    enum { matchcharMarker = 0x80 };            // decoded run flags of a matchchar state, still to be copied from the first taxon
+    enum { transposeTileSize = 64 };            // characters decoded before a transposed matrix is written to matrixGrid
+    bool    isStateCodeTableBuilt;              // true once stateCodes has been compiled for the current FORMAT
+    int     stateCodes[256];                    // per byte, the grid flags of the state it stands for once equates are applied, matchcharCode, or invalidCode if it must be worked out by handleNextState
+    quint64 stateCodeSets[256];                 // per byte, the grid state set of the state it stands for
+    QHash<QString, QString> equateLookup;       // equate symbol -> equivalent, compiled from equatesList
+    bool    isMatrixEndRead;                    // true if the semicolon ending MATRIX was read while recovering from a bad row
+    bool    isStateRunReadable;                 // true if MATRIX rows can be decoded a run of bytes at a time (single symbol DNA, RNA, nucleotide and protein data)
+    QVector<int> matrixColumns;                 // grid column of each character, in characterList order
+    QVector<quint64> runStateSets;              // state sets of the run being decoded
+    QByteArray runFlags;                        // flags of the run being decoded
+
 private:
     dataTypesEnum       datatype;       // flag variable (see datatypes enum)
     statesFormatEnum    statesFormat;   // flag variable (see statesFormat enum)
@@ -45,6 +45,8 @@ NexusParserReader::NexusParserReader(MainWindow *mw, Settings *s)
     settings = s;
     blockList = NULL;
     currentBlock = NULL;
+    progress = NULL;
+    validating = false;
 
     currentWarningMode = WARNINGS_TO_LOG;
 
@@ -71,6 +73,16 @@ NexusParserReader::NexusParserReader(MainWindow *mw, Settings *s)
 }
 
 
+// The block readers, and whatever they still hold, belong to the reader
+NexusParserReader::~NexusParserReader()
+{
+    while (blockList != NULL) {
+        NexusParserBlock *block = blockList;
+        blockList = blockList->next;
+        delete block;
+    }
+}
+
 // Add a block reader
 void NexusParserReader::addBlock(QString blockID)
 {
@@ -91,6 +103,7 @@ void NexusParserReader::loadBlocks()
 
     for(int i = 0; i < blocksToLoad.count(); i++)
     {
+        block = NULL;
         if(blocksToLoad[i] == "TAXA") {
             block = taxaBlock = new NexusParserTaxaBlock(this);
             taxaBlockLoaded = true;
@@ -259,7 +272,15 @@ bool NexusParserReader::execute(NexusParserToken &token)
                         }
                         currentBlock->reset();
                         currentBlock = NULL;
-                        return false;
+
+                        // When validating, an error the block could not recover from only costs the rest of the block
+                        if (!validating || isCancelled() || token.getAtEndOfFile()) {
+                            return false;
+                        }
+                        if (!token.equals("END") && !token.equals("ENDBLOCK") && !readUntilEndblock(token, currentBlockName)) {
+                            return false;
+                        }
+                        continue;
                     }
                     exitingBlock(currentBlockName);
                     postBlockReadingHook(currentBlock);
@@ -277,7 +298,12 @@ bool NexusParserReader::execute(NexusParserToken &token)
         } else if (token.equals("&LEAVE")) {
             break;
         }
-        qApp->processEvents();
+
+        reportProgress(token);
+        if (isCancelled()) {
+            logMesssage("cancelled.");
+            return false;
+        }
     }
 
 
@@ -323,7 +349,7 @@ void NexusParserReader::skippingDisabledBlock(QString currentBlockName)
     logMesssage(QString("BLOCK called \"%1\" is disabled, skipping BLOCK.").arg(currentBlockName));
 }
 
-bool NexusParserReader::readUntilEndblock(NexusParserToken token, QString currentBlockName)
+bool NexusParserReader::readUntilEndblock(NexusParserToken &token, QString currentBlockName)
 {
     for (;;)
     {
@@ -347,12 +373,114 @@ bool NexusParserReader::readUntilEndblock(NexusParserToken token, QString curren
 }
 
 
+/*------------------------------------------------------------------------------------/
+ * Progress Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Publish progress to 'p' as the file is read, and take cancel requests from it
+void NexusParserReader::setProgress(NexusParserProgress *p)
+{
+    progress = p;
+}
+
+void NexusParserReader::reportProgress(NexusParserToken &token)
+{
+    if (progress) {
+        progress->bytesRead.store(token.getFilePosition());
+    }
+}
+
+// Called by the block readers after each MATRIX row. Throws to unwind the block if the import has been cancelled.
+void NexusParserReader::rowRead(NexusParserToken &token)
+{
+    if (!progress) {
+        return;
+    }
+
+    progress->bytesRead.store(token.getFilePosition());
+    progress->rowsRead.ref();
+    if (isCancelled()) {
+        throw NexusParserException("Import cancelled", token.getFilePosition(), token.getFileLine(), token.getFileColumn());
+    }
+}
+
+bool NexusParserReader::isCancelled()
+{
+    return (progress && progress->isCancelRequested.load() != 0);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Validation Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Check a file rather than import it. Errors are collected instead of ending the read, and MATRIX data is
+// not kept.
+void NexusParserReader::setValidating(bool validate)
+{
+    validating = validate;
+}
+
+bool NexusParserReader::isValidating()
+{
+    return validating;
+}
+
+// Every error and warning logged so far, in file order
+QList<NexusParserIssue> NexusParserReader::getIssues()
+{
+    return issues;
+}
+
+int NexusParserReader::countErrors()
+{
+    int count = 0;
+    for (int i = 0; i < issues.count(); i++) {
+        if (issues.at(i).isError) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void NexusParserReader::addIssue(bool isError, QString message, qint64 filePos, qint64 fileLine, qint64 fileCol)
+{
+    NexusParserIssue issue;
+    issue.isError = isError;
+    issue.message = message;
+    issue.filePos = filePos;
+    issue.fileLine = fileLine;
+    issue.fileCol = fileCol;
+    issues.append(issue);
+}
+
+/*------------------------------------------------------------------------------------/
+ * Log Functions
+ *-----------------------------------------------------------------------------------*/
+
+// Write to the main window application log. The log sink may be written from the import thread. Without a main
+// window (the console benchmark) nothing is logged.
+void NexusParserReader::logAppend(LogSink::Level level, QString title, QString message)
+{
+    if (mainwindow) {
+        mainwindow->logSink->append(level, title, message);
+    }
+}
+
+// True if messages of this level are shown. Callers logging per row or per label check it first, so that
+// the message is not even built when it would be dropped.
+bool NexusParserReader::isLogged(LogSink::Level level)
+{
+    return (mainwindow && mainwindow->logSink->isLogged(level));
+}
+
 // Called when an error is encountered in a NEXUS file. Allows program to give user details of the error as well as
 // the precise location of the error via the application log.
 void NexusParserReader::logError(QString message, qint64 filePos, qint64 fileLine, qint64 fileCol)
 {
+    addIssue(true, message, filePos, fileLine, fileCol);
+
     // Write to main window application log
-    mainwindow->logAppend("NEXUS Reader",
+    logAppend(LogSink::Error, "NEXUS Reader",
                           QString("ERROR \"%1\" @ File Position = %2, File Line = %3, File Column = %4.")
                           .arg(message)
                           .arg(filePos)
@@ -368,20 +496,22 @@ void NexusParserReader::logWarning(QString message, LogWarningLevel warnLevel, N
     } else if (warnLevel >= PROBABLY_INCORRECT_CONTENT_WARNING || currentWarningMode == WARNINGS_ARE_ERRORS) {
         throw NexusParserException(message, token.getFilePosition(), token.getFileLine(), token.getFileColumn());
     } else {
+        addIssue(false, message, token.getFilePosition(), token.getFileLine(), token.getFileColumn());
+
         // Write to main window application log
-        mainwindow->logAppend("NEXUS Reader",
+        logAppend(LogSink::Warning, "NEXUS Reader",
                               QString("WARNING \"%1\" @ File Position = %2, File Line = %3, File Column = %4.")
                               .arg(message)
-                              .arg(filePos)
-                              .arg(fileLine)
-                              .arg(fileCol)
+                              .arg(token.getFilePosition())
+                              .arg(token.getFileLine())
+                              .arg(token.getFileColumn())
                               );
     }
 }
 
 // Called when a message is to be logged. Allows program to give user details of the message via the application log.
-void NexusParserReader::logMesssage(QString message)
+void NexusParserReader::logMesssage(QString message, LogSink::Level level)
 {
     // Write to main window application log
-    mainwindow->logAppend("NEXUS Reader",QString("%1").arg(message));
+    logAppend(level, "NEXUS Reader", message);
 }
@@ -61,6 +61,26 @@ class NexusParserBlockFactory;
 class NexusParserBlock;
 class NexusParserException;
 
+// Progress of a running import. Written by the reader on the import thread and read by the GUI thread without
+// locking; isCancelRequested is set by the GUI and checked by the reader at every row and block.
+struct NexusParserProgress
+{
+    QAtomicInteger<qint64> bytesRead;
+    QAtomicInt rowsRead;
+    QAtomicInt isCancelRequested;
+};
+
+// An error or warning found in a NEXUS file. The reader keeps every one it logs, so that a validation run can
+// report all of them once the file has been read.
+struct NexusParserIssue
+{
+    bool isError;
+    QString message;
+    qint64 filePos;
+    qint64 fileLine;
+    qint64 fileCol;
+};
+
 typedef QList<NexusParserBlock *> NexusParserBlockList;
 typedef QMap<QString, NexusParserBlockList> NexusParserBlockIDToBlockList;
 
@@ -68,6 +88,7 @@ class NexusParserReader
 {
 public:
     NexusParserReader(MainWindow *mw, Settings *s);
+    ~NexusParserReader();
 
     MainWindow *mainwindow;
     Settings *settings;
@@ -98,9 +119,20 @@ public:
     void skippingBlock(QString currentBlockName);
     void skippingDisabledBlock(QString currentBlockName);
 
+    void setProgress(NexusParserProgress *p);
+    void reportProgress(NexusParserToken &token);
+    void rowRead(NexusParserToken &token);
+    bool isCancelled();
+
+    void setValidating(bool validate);
+    bool isValidating();
+    QList<NexusParserIssue> getIssues();
+    int countErrors();
+
     void logError(QString message, qint64 filePos, qint64	fileLine, qint64 fileCol);
     void logWarning(QString message, LogWarningLevel warnLevel, NexusParserToken &token);
-    void logMesssage(QString message);
+    void logMesssage(QString message, LogSink::Level level = LogSink::Info);
+    bool isLogged(LogSink::Level level);
 
     NexusParserBlockIDToBlockList getUsedBlocks();
 
@@ -130,7 +162,16 @@ protected:
 
 
 private:
-    bool readUntilEndblock(NexusParserToken token, QString currentBlockName);
+    bool readUntilEndblock(NexusParserToken &token, QString currentBlockName);
+    void logAppend(LogSink::Level level, QString title, QString message);
+
+    NexusParserProgress *progress;
+
+    // In validation mode the block readers log an error and carry on at the next command or MATRIX row, and
+    // the MATRIX is checked without being kept
+    bool validating;
+    QList<NexusParserIssue> issues;
+    void addIssue(bool isError, QString message, qint64 filePos, qint64 fileLine, qint64 fileCol);
 
     NexusParserBlockIDToBlockList blockIDToBlockList;
     void addBlockToUsedBlockList(const QString &, NexusParserBlock *);
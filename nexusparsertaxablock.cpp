@@ -65,40 +65,48 @@ void NexusParserTaxaBlock::read(NexusParserToken &token)
     for (;;)
     {
         token.getNextToken();
-        NexusParserBlock::NexusParserCommandResult result = handleBasicBlockCommands(token);
+        try {
+            NexusParserBlock::NexusParserCommandResult result = handleBasicBlockCommands(token);
 
-        if (result == NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK)){
-            return;
-        }
-        if (result != NexusParserBlock::NexusParserCommandResult(HANDLED_COMMAND)){
-            if (token.equals("DIMENSIONS")){
-                nominalTaxaNumber = handleDimensions(token, "NTAX");
-            } else if (token.equals("TAXLABELS")) {
-                if (nominalTaxaNumber <= 0) {
-                    throw NexusParserException("NTAX must be specified before TAXLABELS command", token.getFilePosition(), token.getFileLine(), token.getFileColumn());
-                }
-
-                nexusParser->logMesssage(QString("TAXA Block: found command \"TAXLABELS\" on line %1, now extracting taxon labels...").arg(token.getFileLine()));
-
-                for (int i = 0; i < nominalTaxaNumber; i++)
-                {
-                    token.getNextToken();
-                    // Should check to make sure this is not punctuation
-                    taxonAdd(token.getToken());
-                    nexusParser->logMesssage(QString("TAXA Block: extracted taxon label [T%1] -> %2.").arg(i+1).arg(token.getToken()));
-                }
-                demandEndSemicolon(token, "TAXLABELS");
-            } else {
-                skippingCommand(token.getToken());
-                do {
-                    token.getNextToken();
-                } while (!token.getAtEndOfFile() && !token.equals(";"));
-
-                if (token.getAtEndOfFile()){
-                    errorMessage = "Unexpected end of file encountered";
-                    throw NexusParserException(errorMessage, token.getFilePosition(), token.getFileLine(), token.getFileColumn());
+            if (result == NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK)){
+                return;
+            }
+            if (result != NexusParserBlock::NexusParserCommandResult(HANDLED_COMMAND)){
+                if (token.equals("DIMENSIONS")){
+                    nominalTaxaNumber = handleDimensions(token, "NTAX");
+                } else if (token.equals("TAXLABELS")) {
+                    if (nominalTaxaNumber <= 0) {
+                        throw NexusParserException("NTAX must be specified before TAXLABELS command", token.getFilePosition(), token.getFileLine(), token.getFileColumn());
+                    }
+
+                    nexusParser->logMesssage(QString("TAXA Block: found command \"TAXLABELS\" on line %1, now extracting taxon labels...").arg(token.getFileLine()));
+
+                    for (int i = 0; i < nominalTaxaNumber; i++)
+                    {
+                        token.getNextToken();
+                        // Should check to make sure this is not punctuation
+                        taxonAdd(token.getToken());
+                        if (nexusParser->isLogged(LogSink::Debug)) {
+                            nexusParser->logMesssage(QString("TAXA Block: extracted taxon label [T%1] -> %2.").arg(i+1).arg(token.getToken()), LogSink::Debug);
+                        }
+                    }
+                    demandEndSemicolon(token, "TAXLABELS");
+                } else {
+                    skippingCommand(token.getToken());
+                    do {
+                        token.getNextToken();
+                    } while (!token.getAtEndOfFile() && !token.equals(";"));
+
+                    if (token.getAtEndOfFile()){
+                        errorMessage = "Unexpected end of file encountered";
+                        throw NexusParserException(errorMessage, token.getFilePosition(), token.getFileLine(), token.getFileColumn());
+                    }
                 }
             }
+        } catch (NexusParserException &x) {
+            if (recoverAtCommandEnd(token, x) == NexusParserBlock::NexusParserCommandResult(STOP_PARSING_BLOCK)) {
+                return;
+            }
         }
     }
 }
@@ -142,6 +150,12 @@ int NexusParserTaxaBlock::taxonAdd(QString taxonLabel)
     isEmpty = false;
     taxonList.append(Taxon(nextTaxonID,taxonLabel,""));
     nextTaxonID++;
+
+    // A repeated label keeps pointing at the first taxon, as the list search did
+    QString key = labelKey(taxonLabel);
+    if (!taxonPositions.contains(key)) {
+        taxonPositions.insert(key, taxonList.count()-1);
+    }
     return (taxonList.count());
 }
 
@@ -163,32 +177,31 @@ void NexusParserTaxaBlock::reset()
     isEmpty = true;
     nextTaxonID = 0;
     taxonList.clear();
+    taxonPositions.clear();
+}
+
+// NEXUS taxon labels are not case sensitive, so the lookup hash is keyed on the upper case label
+QString NexusParserTaxaBlock::labelKey(QString label)
+{
+    return label.toUpper();
 }
 
 // Returns index of taxon named 'str' in taxonLabels list. If taxon named 'str' cannot be found, or if there are no
 // labels currently stored in the taxonLabels list, throws NexusParserX_NoSuchTaxon exception.
 int NexusParserTaxaBlock::taxonFind(QString &str)
 {
-    for (int i = 0; i < taxonList.count(); ++i)
-    {
-        if (taxonList[i].getLabel() == str){
-            return i;
-        }
+    QHash<QString, int>::const_iterator i = taxonPositions.constFind(labelKey(str));
+    if (i == taxonPositions.constEnd()) {
+        throw NexusParserTaxaBlock::NexusParserX_NoSuchTaxon();
     }
-    throw NexusParserTaxaBlock::NexusParserX_NoSuchTaxon();
+    return i.value();
 }
 
 // Returns Taxon ID of taxon named 'str' in taxonLabels list. If taxon named 'str' cannot be found, or if there are no
 // labels currently stored in the taxonLabels list, throws NexusParserX_NoSuchTaxon exception.
 int NexusParserTaxaBlock::taxonIDFind(QString &str)
 {
-    for (int i = 0; i < taxonList.count(); ++i)
-    {
-        if (taxonList[i].getLabel() == str){
-            return taxonList[i].getID();
-        }
-    }
-    throw NexusParserTaxaBlock::NexusParserX_NoSuchTaxon();
+    return taxonList[taxonFind(str)].getID();
 }
 
 // Returns Taxon ID of taxon at the list position given by 'position'.
@@ -200,20 +213,31 @@ int NexusParserTaxaBlock::getTaxonID(int position)
 // Returns true if taxon label equal to 'str' can be found in the taxonLabels list, and returns false otherwise.
 bool NexusParserTaxaBlock::taxonIsDefined(QString str)
 {
-    bool found = false;
-
-    for(int i = 0; i < taxonList.count(); i++)
-    {
-        if (taxonList[i].getLabel() == str) {
-            found = true;
-        }
-    }
-
-    return found;
+    return taxonPositions.contains(labelKey(str));
 }
 
 // Move the selected taxon in 'currentPosition' to 'requiredPosition' within the taxonList.
 void NexusParserTaxaBlock::taxonMove(int currentPosition, int requiredPosition)
 {
     taxonList.move(currentPosition, requiredPosition);
+
+    // Only the taxa between the two positions have shifted. Walking down the range leaves each label pointing at
+    // its first position, unless that is still an earlier taxon outside the range.
+    int first = qMin(currentPosition, requiredPosition);
+    int last = qMax(currentPosition, requiredPosition);
+    for (int i = last; i >= first; i--) {
+        QString key = labelKey(taxonList[i].getLabel());
+        QHash<QString, int>::iterator position = taxonPositions.find(key);
+        if (position == taxonPositions.end() || position.value() >= first) {
+            taxonPositions.insert(key, i);
+        }
+    }
+}
+
+// Hand the taxa over to 'list' (a Matrix being created from the file) without copying them, the block is left empty.
+void NexusParserTaxaBlock::takeTaxa(QList<Taxon> &list)
+{
+    list.clear();
+    list.swap(taxonList);
+    taxonPositions.clear();
 }
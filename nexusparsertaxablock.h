@@ -62,6 +62,7 @@ public:
     int getTaxonID(int position);
     bool taxonIsDefined(QString str);
     void taxonMove(int currentPosition, int requiredPosition);
+    void takeTaxa(QList<Taxon> &list);
 
     class NexusParserX_NoSuchTaxon {};	// thrown if findTaxon cannot locate a supplied taxon label in the taxonLabels vector
 
@@ -71,6 +72,8 @@ protected:
 
     int nextTaxonID;
     QList<Taxon> taxonList;
+    QHash<QString, int> taxonPositions;     // label key -> position in taxonList of the first taxon with that label
+    QString labelKey(QString label);
 
     int ntax; // == ntax, number of taxa found
 };
@@ -45,51 +45,99 @@
 * repeatedly calling the getNextToken() function and then interpreting the token returned.
 *----------------------------------------------------------------------------------------------------------------------*/
 
-NexusParserToken::NexusParserToken(QTextStream &i) : in(i)
+// Tokenize a file in place, mapping it into memory where the platform allows
+NexusParserToken::NexusParserToken(QFile &file)
 {
+    initialize();
 
-    nexusData = in.readAll();
+    uchar *mapping = 0;
+    if (file.size() > 0) {
+        mapping = file.map(0, file.size());
+    }
+    if (mapping) {
+        setData(mapping, file.size());
+    } else {
+        // Not mappable (e.g. a pipe), read it in as bytes instead
+        dataBuffer = file.readAll();
+        setData(reinterpret_cast<const uchar *>(dataBuffer.constData()), dataBuffer.size());
+    }
+}
+
+// Tokenize text already opened as a stream, the text is converted once to UTF-8 bytes
+NexusParserToken::NexusParserToken(QTextStream &i)
+{
+    initialize();
+
+    dataBuffer = i.readAll().toUtf8();
+    setData(reinterpret_cast<const uchar *>(dataBuffer.constData()), dataBuffer.size());
+}
+
+void NexusParserToken::initialize()
+{
+    data = 0;
+    dataSize = 0;
 
     atEndOfFile = false;
     atEndOfLine = false;
     fileCol = Q_INT64_C(1);
     fileLine = Q_INT64_C(1);
     filePos = Q_INT64_C(0);
+    charPos = Q_INT64_C(0);
     labileFlags	= 0;
-    saved = QChar('\0');
-    special = QChar('\0');
-
-    whitespace.append(QChar(' '));
-    whitespace.append(QChar('\t'));
-    whitespace.append(QChar('\n'));
-    whitespace.append(QChar('\0'));
-
-    punctuation.append(QChar('('));
-    punctuation.append(QChar(')'));
-    punctuation.append(QChar('['));
-    punctuation.append(QChar(']'));
-    punctuation.append(QChar('{'));
-    punctuation.append(QChar('}'));
-    punctuation.append(QChar('/'));
-    punctuation.append(QChar('\\'));
-    punctuation.append(QChar(','));
-    punctuation.append(QChar(';'));
-    punctuation.append(QChar(':'));
-    punctuation.append(QChar('='));
-    punctuation.append(QChar('*'));
-    punctuation.append(QChar('\''));
-    punctuation.append(QChar('"'));
-    punctuation.append(QChar('`'));
-    punctuation.append(QChar('+'));
-    punctuation.append(QChar('-'));
-    punctuation.append(QChar('<'));
-    punctuation.append(QChar('>'));
-    punctuation.append(QChar('\0'));
+    saved = '\0';
+    special = '\0';
+
+    tokenStart = 0;
+    tokenLength = 0;
+    isTokenView = false;
+    isTokenStringValid = false;
+
+    whitespace.append(' ');
+    whitespace.append('\t');
+    whitespace.append('\n');
+    whitespace.append('\0');
+
+    punctuation.append('(');
+    punctuation.append(')');
+    punctuation.append('[');
+    punctuation.append(']');
+    punctuation.append('{');
+    punctuation.append('}');
+    punctuation.append('/');
+    punctuation.append('\\');
+    punctuation.append(',');
+    punctuation.append(';');
+    punctuation.append(':');
+    punctuation.append('=');
+    punctuation.append('*');
+    punctuation.append('\'');
+    punctuation.append('"');
+    punctuation.append('`');
+    punctuation.append('+');
+    punctuation.append('-');
+    punctuation.append('<');
+    punctuation.append('>');
+    punctuation.append('\0');
+
+    classTablesBuilt = 0;
+    selectClassTable();
+}
+
+void NexusParserToken::setData(const uchar *bytes, qint64 size)
+{
+    data = reinterpret_cast<const char *>(bytes);
+    dataSize = size;
+
+    // Skip a UTF-8 byte order mark
+    if (dataSize >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        filePos = 3;
+    }
 }
 
 void NexusParserToken::setLabileFlagBit(int bit)
 {
     labileFlags |= bit;
+    selectClassTable();
 }
 
 // Advances the token, and returns the unsigned int that the token represents
@@ -127,6 +175,11 @@ qint64 NexusParserToken::getFileLine() const
     return fileLine;
 }
 
+qint64 NexusParserToken::getFileSize() const
+{
+    return dataSize;
+}
+
 bool NexusParserToken::getAtEndOfFile()
 {
     return atEndOfFile;
@@ -137,92 +190,167 @@ bool NexusParserToken::getAtEndOfLine()
     return atEndOfLine;
 }
 
-// Returns token in upper case (default), set toUpper to false to keep case
+// Returns the token as text, converting it from the input bytes the first time it is asked for
 QString NexusParserToken::getToken(bool respectCase)
 {
+    if (!isTokenStringValid) {
+        QByteArray bytes = getTokenBytes();
+        tokenString = QString::fromUtf8(bytes.constData(), bytes.size());
+        isTokenStringValid = true;
+    }
+
     if (!respectCase) {
-        return token.toUpper();
+        return tokenString.toUpper();
     } else {
-        return token;
+        return tokenString;
+    }
+}
+
+// Returns the raw bytes of the token without copying them, only valid until the next token is read
+QByteArray NexusParserToken::getTokenBytes()
+{
+    if (isTokenView) {
+        return QByteArray::fromRawData(data + tokenStart, tokenLength);
+    }
+    return tokenBuffer;
+}
+
+// Returns the raw bytes of the token and their number in 'length', without building a QByteArray. Only valid until
+// the next token is read.
+const char *NexusParserToken::getTokenData(int &length)
+{
+    if (isTokenView) {
+        length = tokenLength;
+        return data + tokenStart;
     }
+    length = tokenBuffer.size();
+    return tokenBuffer.constData();
 }
 
 // Returns token.size()
 int NexusParserToken::getTokenLength()
 {
-    return token.size();
+    return (isTokenView ? tokenLength : tokenBuffer.size());
 }
 
 // Returns true if current token is a single character and this character is either '+' or '-'.
 bool NexusParserToken::isPlusMinusToken()
 {
-    if (token.size() == 1 && (token[0] == '+' || token[0] == '-')){
-        return true;
-    } else {
-        return false;
-    }
+    int length;
+    const char *bytes = getTokenData(length);
+    return (length == 1 && (bytes[0] == '+' || bytes[0] == '-'));
 }
 
 // Returns true if current token is a single character and this character is a punctuation character (as defined in
 // IsPunctuation function).
 bool NexusParserToken::isPunctuationToken()
 {
-    if (token.size() == 1 && isPunctuation(QChar(token[0]))){
-        return true;
-    } else {
-        return false;
-    }
+    int length;
+    const char *bytes = getTokenData(length);
+    return (length == 1 && isPunctuation(bytes[0]));
 }
 
 // Returns true if current token is a single character and this character is a whitespace character (as defined in
 // IsWhitespace function).
 bool NexusParserToken::isWhitespaceToken()
 {
-    if (token.size() == 1 && isWhitespace(QChar(token[0]))){
-        return true;
-    } else {
-        return false;
-    }
+    int length;
+    const char *bytes = getTokenData(length);
+    return (length == 1 && isWhitespace(bytes[0]));
 }
 
 //Strips whitespace from currently-stored token. Removes leading, trailing, and embedded whitespace characters.
 void NexusParserToken::stripWhitespace()
 {
-    QString str;
-    for (int i = 0; i < token.size(); i++)
+    QByteArray bytes = getTokenBytes();
+    QByteArray stripped;
+    stripped.reserve(bytes.size());
+    for (int i = 0; i < bytes.size(); i++)
     {
-        if (isWhitespace(token.at(i))) {
+        if (isWhitespace(bytes.at(i))) {
             continue;
         }
-        str.append(token[i]);
+        stripped.append(bytes.at(i));
     }
-    token = str;
+    tokenBuffer = stripped;
+    isTokenView = false;
+    isTokenStringValid = false;
+}
+
+// Compare the token with an ASCII string, e.g. a command name, on its bytes. Only a case insensitive comparison of
+// a token that is not plain ASCII needs it as text.
+bool NexusParserToken::equals(const char *str, bool respectCase)
+{
+    int length;
+    const char *bytes = getTokenData(length);
+    for (int i = 0; i < length; i++) {
+        if (!respectCase && (uchar)bytes[i] >= 0x80) {
+            return (getToken().compare(QLatin1String(str), Qt::CaseInsensitive) == 0);
+        }
+        if (str[i] == '\0') {
+            return false;
+        }
+        if (bytes[i] != str[i] && (respectCase || asciiUpper(bytes[i]) != asciiUpper(str[i]))) {
+            return false;
+        }
+    }
+    return (str[length] == '\0');
 }
 
 bool NexusParserToken::equals(QString str, bool respectCase)
 {
-    QString tokenStr = token;
-    if (!respectCase) {
-        tokenStr.toUpper();
-        str.toUpper();
+    int length;
+    const char *bytes = getTokenData(length);
+    bool isAscii = (str.size() == length);
+    for (int i = 0; i < length && isAscii; i++) {
+        isAscii = ((uchar)bytes[i] < 0x80 && str.at(i).unicode() < 0x80);
+    }
+    if (!isAscii) {
+        // Different lengths can still match once the token is decoded or case folded
+        return (getToken().compare(str, (respectCase ? Qt::CaseSensitive : Qt::CaseInsensitive)) == 0);
     }
 
-    if (str != tokenStr) {
-        return false;
-    } else {
-        return true;
+    for (int i = 0; i < length; i++) {
+        char ch = (char)str.at(i).unicode();
+        if (bytes[i] != ch && (respectCase || asciiUpper(bytes[i]) != asciiUpper(ch))) {
+            return false;
+        }
     }
+    return true;
+}
+
+char NexusParserToken::asciiUpper(char ch)
+{
+    return ((ch >= 'a' && ch <= 'z') ? (char)(ch - 'a' + 'A') : ch);
 }
 
 /*------------------------------------------------------------------------------------/
  * Append functions
  *-----------------------------------------------------------------------------------*/
-void NexusParserToken::appendToToken(QChar ch)
+// Grow the token by one character. While every character is the next byte of the input the token stays a view,
+// the first one that is not (a converted underscore, a paired quote, text after a comment) copies it to tokenBuffer.
+void NexusParserToken::appendToToken(char ch)
 {
-    token.append(ch);
+    isTokenStringValid = false;
+
+    if (isTokenView) {
+        if (charPos == tokenStart + tokenLength && data[charPos] == ch) {
+            tokenLength++;
+            return;
+        }
+        tokenBuffer = QByteArray(data + tokenStart, tokenLength);
+        isTokenView = false;
+    } else if (tokenBuffer.isEmpty() && charPos < dataSize && data[charPos] == ch) {
+        isTokenView = true;
+        tokenStart = charPos;
+        tokenLength = 1;
+        return;
+    }
+
+    tokenBuffer.append(ch);
 }
 
-void NexusParserToken::appendToComment(QChar ch)
+void NexusParserToken::appendToComment(char ch)
 {
     comment.append(ch);
 }
@@ -234,6 +362,53 @@ void NexusParserToken::outputComment(const QString)
 {
 }
 
+// Gives readers that can decode plain runs of bytes themselves (e.g. sequence rows in a MATRIX) direct access to
+// the unread input. Returns the number of bytes available at 'bytes', or 0 while a character is held back in saved.
+qint64 NexusParserToken::peekBytes(const char *&bytes)
+{
+    if (saved != '\0' || filePos >= dataSize) {
+        bytes = 0;
+        return 0;
+    }
+    bytes = data + filePos;
+    return (dataSize - filePos);
+}
+
+// Step over 'length' bytes returned by peekBytes(). The bytes must not contain line breaks.
+void NexusParserToken::skipBytes(qint64 length)
+{
+    Q_ASSERT(saved == '\0' && filePos + length <= dataSize);
+
+    filePos += length;
+    fileCol += length;
+    charPos = filePos - 1;
+    atEndOfLine = false;
+}
+
+// Step over the rest of the current line, stopping before the line break or before a ';' so that it is still read as
+// a token. Used to carry on at the next MATRIX row after an error. Returns true if the line break was reached.
+bool NexusParserToken::skipRestOfLine()
+{
+    if (saved == ';') {
+        return false;
+    } else if (saved == '\n') {
+        return true;
+    }
+    saved = '\0';
+
+    while (filePos < dataSize) {
+        char ch = data[filePos];
+        if (ch == 13 || ch == 10) {
+            return true;
+        } else if (ch == ';') {
+            return false;
+        }
+        filePos++;
+        fileCol++;
+    }
+    return false;
+}
+
 /* Reads next character from file and does all of the following before returning it to the calling function:
 *
 *	o if character read is either a carriage return or line feed, the variable line is incremented by one and the
@@ -243,46 +418,34 @@ void NexusParserToken::outputComment(const QString)
 *	o if either a carriage return or line feed is read, the character returned to the calling function is '\n' if
 *	  character read is neither a carriage return nor a line feed, fileCol is incremented by one and the character is
 *	  returned as is to the calling function
-*	o in all cases, the variable filePos is updated using a call to the pos function of QTextStream.
+*	o in all cases, the variable filePos is advanced past the bytes read
 */
 
-QChar NexusParserToken::getNextChar()
+char NexusParserToken::getNextChar()
 {
-    QChar ch, chNext;
-
-    if (!atEndOfFile){
-        ch = nexusData.at(filePos);
-        filePos++;
+    if (filePos >= dataSize) {
+        atEndOfFile = true;
+        return '\0';
     }
 
-    if (nexusData.size()-1 == filePos) {
-        atEndOfFile = true;
-    } else {
-        chNext = nexusData.at(filePos+1);
+    charPos = filePos;
+    char ch = data[filePos++];
 
-        if (ch == 13 || ch == 10) {
-            fileLine++;
-            fileCol = Q_INT64_C(1);
+    if (ch == 13 || ch == 10) {
+        fileLine++;
+        fileCol = Q_INT64_C(1);
 
-            if (ch == 13 && chNext == 10){
-                ch = nexusData.at(filePos);
-                filePos++;
-            }
-            atEndOfLine = true;
-        } else {
-            fileCol++;
-            atEndOfLine = false;
+        if (ch == 13 && filePos < dataSize && data[filePos] == 10){
+            charPos = filePos;
+            filePos++;
         }
+        atEndOfLine = true;
+        return '\n';
     }
 
-
-    if (atEndOfFile){
-        return QChar('\0');
-    } else if (atEndOfLine){
-        return QChar('\n');
-    } else {
-        return QChar(ch);
-    }
+    fileCol++;
+    atEndOfLine = false;
+    return ch;
 }
 
 /*	Reads characters from in until a complete token has been read and stored in token. getNextToken performs a number
@@ -313,9 +476,9 @@ void NexusParserToken::getNextToken()
 {
     resetToken();
 
-    QChar ch = QChar(' ');
+    char ch = ' ';
 
-    if (saved == QChar('\0') || isWhitespace(saved)) {
+    if (saved == '\0' || isWhitespace(saved)) {
         // Skip leading whitespace
         while(isWhitespace(ch) && !atEndOfFile) {
             ch = getNextChar();
@@ -325,13 +488,13 @@ void NexusParserToken::getNextToken()
 
     for(;;) {
         // Break now if singleCharacterToken mode on and token length > 0.
-        if (labileFlags & singleCharacterToken && token.size() > 0) {
+        if (labileFlags & singleCharacterToken && getTokenLength() > 0) {
             break;
         }
         // Get next character either from saved or from input stream.
-        if (saved != QChar('\0')) {
+        if (saved != '\0') {
             ch = saved;
-            saved = QChar('\0');
+            saved = '\0';
         } else {
             ch = getNextChar();
         }
@@ -342,7 +505,7 @@ void NexusParserToken::getNextToken()
         }
 
         if (ch == '\n' && labileFlags & newlineIsToken) {
-            if (token.size() > 0) {
+            if (getTokenLength() > 0) {
                 // Newline came after token, save newline until next time when it will be reported as a separate token.
                 atEndOfLine = 0;
                 saved = ch;
@@ -354,45 +517,45 @@ void NexusParserToken::getNextToken()
         } else if (isWhitespace(ch)) {
             // Break only if we've begun adding to token (remember, if we hit a comment before a token,
             // there might be further white space between the comment and the next token).
-            if (token.size() > 0) {
+            if (getTokenLength() > 0) {
                 break;
             }
         } else if (ch == '_') {
             // If underscores are discovered in unquoted tokens, they should be automatically converted to spaces.
             if (!(labileFlags & preserveUnderscores)){
-                ch = QChar(' ');
+                ch = ' ';
             }
             appendToToken(ch);
-        } else if (ch == QChar('[')) {
+        } else if (ch == '[') {
             // Get rest of comment and deal with it, but notice that we only break if the comment ends a token,
             // not if it starts one (comment counts as whitespace). In the case of command comments
             // (if saveCommandComment) GetComment will add to the token NxsString, causing us to break because
             // token.size() will be greater than 0.
             comment.clear();
             getComment();
-            if (token.size() > 0) {
+            if (getTokenLength() > 0) {
                 break;
             }
-        } else if (ch == QChar('(') && labileFlags & parentheticalToken) {
+        } else if (ch == '(' && labileFlags & parentheticalToken) {
             appendToToken(ch);
             // Get rest of parenthetical token.
             getParentheticalToken();
             break;
-        } else if (ch == QChar('{') && labileFlags & curlyBracketedToken) {
+        } else if (ch == '{' && labileFlags & curlyBracketedToken) {
             appendToToken(ch);
             // Get rest of curly-bracketed token.
             getCurlyBracketedToken();
             break;
-        } else if (ch == QChar('\"') && labileFlags & doubleQuotedToken) {
+        } else if (ch == '\"' && labileFlags & doubleQuotedToken) {
             // Get rest of double-quoted token.
             getDoubleQuotedToken();
             break;
-        } else if (ch == QChar('\'')) {
-            if (token.size() > 0) {
+        } else if (ch == '\'') {
+            if (getTokenLength() > 0) {
                 // We've encountered a single quote after a token has already begun to be read; should be another tandem
                 // single quote character immediately following.
                 ch = getNextChar();
-                if (ch == QChar('\'')) {
+                if (ch == '\'') {
                     appendToToken(ch);
                 } else {
                     QString errormessage = "Expecting second single quote character";
@@ -405,7 +568,7 @@ void NexusParserToken::getNextToken()
             break;
 
         } else if (isPunctuation(ch)){
-            if (token.size() > 0){
+            if (getTokenLength() > 0){
                 // If we've already begun reading the token, encountering a punctuation character means we should stop, saving
                 // the punctuation character for the next token.
                 saved = ch;
@@ -421,60 +584,77 @@ void NexusParserToken::getNextToken()
         }
     }
     labileFlags = 0;
+    selectClassTable();
 }
 
 void NexusParserToken::resetToken()
 {
-    token.clear();
+    isTokenView = false;
+    tokenLength = 0;
+    tokenBuffer.resize(0);
+    isTokenStringValid = false;
 }
 
 /*------------------------------------------------------------------------------------/
  * Character Matching Functions
  *-----------------------------------------------------------------------------------*/
 
-bool NexusParserToken::searchForCharInList(QList<QChar> searchIn, QChar searchFor)
+bool NexusParserToken::isWhitespace(char ch)
 {
-    for (int i = 0; i < searchIn.count(); i++){
-        if (searchIn[i] == searchFor) {
-            return true;
-        }
-    }
-    return false;
+    return (classTable[(uchar)ch] & whitespaceClass);
 }
 
-bool NexusParserToken::isWhitespace(QChar ch)
+bool NexusParserToken::isPunctuation(char ch)
 {
-    bool isWhitespace = false;
+    return (classTable[(uchar)ch] & punctuationClass);
+}
 
-    // If ch is found in the whitespace array, it's whitespace
-    if (searchForCharInList(whitespace, ch)) {
-        isWhitespace = true;
-    }
-    // Unless of course ch is the newline character and we're currently treating newlines as darkspace!
-    if (labileFlags & newlineIsToken && ch == QChar('\n')) {
-        isWhitespace = false;
+// Point classTable at the table for the current labile flags, building it if this combination has not been seen yet
+void NexusParserToken::selectClassTable()
+{
+    int index = 0;
+    if (labileFlags & newlineIsToken)
+        index |= 0x01;
+    if (labileFlags & tildeIsPunctuation)
+        index |= 0x02;
+    if (labileFlags & useSpecialPunctuation)
+        index |= 0x04;
+    if (labileFlags & hyphenNotPunctuation)
+        index |= 0x08;
+    if (labileFlags & ignorePunctuation)
+        index |= 0x10;
+
+    classTable = classTables[index];
+    if (classTablesBuilt & (1u << index)) {
+        return;
     }
 
-    return isWhitespace;
-}
+    memset(classTable, 0, 256);
+    for (int i = 0; i < whitespace.size(); i++) {
+        classTable[(uchar)whitespace.at(i)] |= whitespaceClass;
+    }
+    if (!(labileFlags & ignorePunctuation)) {
+        for (int i = 0; i < punctuation.size(); i++) {
+            classTable[(uchar)punctuation.at(i)] |= punctuationClass;
+        }
+    }
 
-bool NexusParserToken::isPunctuation(QChar ch)
-{
-    bool isPunctuation = false;
+    // Unless of course ch is the newline character and we're currently treating newlines as darkspace!
+    if (labileFlags & newlineIsToken) {
+        classTable[(uchar)'\n'] &= ~whitespaceClass;
+    }
 
     // PAUP 4.0b10
     //  o allows ]`<> inside taxon names
     //  o allows `<> inside taxset names
-    if (searchForCharInList(punctuation, ch))
-        isPunctuation = true;
-    if (labileFlags & tildeIsPunctuation  && ch == '~')
-        isPunctuation = true;
-    if (labileFlags & useSpecialPunctuation  && ch == special)
-        isPunctuation = true;
-    if (labileFlags & hyphenNotPunctuation  && ch == '-')
-        isPunctuation = false;
+    if (labileFlags & tildeIsPunctuation)
+        classTable[(uchar)'~'] |= punctuationClass;
+    if (labileFlags & useSpecialPunctuation)
+        classTable[(uchar)special] |= punctuationClass;
+    if (labileFlags & hyphenNotPunctuation)
+        classTable[(uchar)'-'] &= ~punctuationClass;
 
-    return isPunctuation;
+    classTablesBuilt |= (1u << index);
 }
 
 /*------------------------------------------------------------------------------------/
@@ -541,7 +721,7 @@ bool NexusParserToken::needsQuotes(const QString &str)
 // found. The tandem quotes are stored as a single quote character in the token NxsString.
 void NexusParserToken::getQuoted()
 {
-    QChar ch;
+    char ch;
 
     for(;;){
         ch = getNextChar();
@@ -582,7 +762,7 @@ void NexusParserToken::getComment()
     int level = 1;
 
     // Get first character
-    QChar ch = getNextChar();
+    char ch = getNextChar();
 
     if (atEndOfFile){
         errorMessage = "Unexpected end of file inside comment";
@@ -594,10 +774,10 @@ void NexusParserToken::getComment()
     bool command = false;
     if (ch == '!'){
         printing = true;
-    } else if (ch == QChar('&') && labileFlags & saveCommandComments){
+    } else if (ch == '&' && labileFlags & saveCommandComments){
         command = true;
         appendToToken(ch);
-    } else if (ch == QChar(']')) {
+    } else if (ch == ']') {
         return;
     }
 
@@ -609,9 +789,9 @@ void NexusParserToken::getComment()
             break;
         }
 
-        if (ch == QChar(']')) {
+        if (ch == ']') {
             level--;
-        } else if (ch == QChar('[')) {
+        } else if (ch == '[') {
             level++;
         }
 
@@ -628,7 +808,7 @@ void NexusParserToken::getComment()
 
     if (printing){
         // Allow output comment to be printed or displayed in most appropriatemanner for target operating system
-        outputComment(comment);
+        outputComment(QString::fromUtf8(comment));
     }
 }
 
@@ -638,7 +818,7 @@ void NexusParserToken::getParentheticalToken()
 {
     // Set level to 1 initially.  Every ')' encountered reduces level by one, so that we know we can stop when level becomes 0.
     int level = 1;
-    QChar ch;
+    char ch;
 
     for(;;)
     {
@@ -646,9 +826,9 @@ void NexusParserToken::getParentheticalToken()
         if (atEndOfFile)
             break;
 
-        if (ch == QChar(')')) {
+        if (ch == ')') {
             level--;
-        } else if (ch == QChar('(')) {
+        } else if (ch == '(') {
             level++;
         }
 
@@ -666,7 +846,7 @@ void NexusParserToken::getCurlyBracketedToken()
     {
     // Set level to 1 initially.  Every '}' encountered reduceslevel by one, so that we know we can stop when level becomes 0.
     int level = 1;
-    QChar ch;
+    char ch;
 
     for(;;)
     {
@@ -675,9 +855,9 @@ void NexusParserToken::getCurlyBracketedToken()
             break;
         }
 
-        if (ch == QChar('}')) {
+        if (ch == '}') {
             level--;
-        } else if (ch == QChar('{')) {
+        } else if (ch == '{') {
             level++;
         }
 
@@ -697,7 +877,7 @@ void NexusParserToken::getCurlyBracketedToken()
 // itself (not paired with another tandem single quote).
 void NexusParserToken::getDoubleQuotedToken()
 {
-    QChar ch;
+    char ch;
 
     for(;;)
     {
@@ -706,7 +886,7 @@ void NexusParserToken::getDoubleQuotedToken()
             break;
         }
 
-        if (ch == QChar('\"')){
+        if (ch == '\"'){
             break;
         } else {
             appendToToken(ch);
@@ -717,5 +897,8 @@ void NexusParserToken::getDoubleQuotedToken()
 // Replaces the current token with the given 'str'
 void NexusParserToken::replaceToken(QString str)
 {
-    token = str;
+    tokenBuffer = str.toUtf8();
+    isTokenView = false;
+    tokenString = str;
+    isTokenStringValid = true;
 }
@@ -44,9 +44,16 @@
 
 class NexusParserException;
 
+// Tokens are read straight out of the raw bytes of the file, which is memory mapped where possible rather than
+// being read into a QString first. While a token is a single unbroken run of the input it is only a view into
+// those bytes, it is copied into a buffer when it has to be rewritten (e.g. underscores to blanks or paired
+// quotes) and only turned into a QString when getToken() is asked for one. Block readers test tokens with
+// equals() and getTokenData(), which work on the bytes, and only call getToken() for tokens they keep. The file
+// must stay open for as long as the token is in use, closing it releases the mapping.
 class NexusParserToken
 {
 public:
+    NexusParserToken(QFile &file);
     NexusParserToken(QTextStream &i);
 
     static  QString escapeString(const QString &);
@@ -57,9 +64,12 @@ public:
     qint64  getFileColumn() const;
     qint64  getFilePosition() const;
     qint64  getFileLine() const;
+    qint64  getFileSize() const;
     bool    getAtEndOfFile();
     bool    getAtEndOfLine();
     QString getToken(bool respectCase = true);
+    QByteArray getTokenBytes();
+    const char *getTokenData(int &length);
     void    getNextToken();
     int     getTokenLength();
 
@@ -71,10 +81,15 @@ public:
     void    resetToken();
 
     void    stripWhitespace();
+    bool    equals(const char *str, bool respectCase = true);
     bool    equals(QString str, bool respectCase = true);
 
     void    setLabileFlagBit(int bit);
 
+    qint64  peekBytes(const char *&bytes);
+    void    skipBytes(qint64 length);
+    bool    skipRestOfLine();
+
     virtual void outputComment(const QString str);
 
     /* For use with the variable labileFlags */
@@ -95,41 +110,61 @@ public:
     QString errorMessage;
 
 protected:
-    void    appendToToken(QChar ch);
-    void    appendToComment(QChar ch);
+    void    appendToToken(char ch);
+    void    appendToComment(char ch);
 
-    QChar   getNextChar();
+    char    getNextChar();
     void    getQuoted();
     void    getComment();
     void    getParentheticalToken();
     void    getCurlyBracketedToken();
     void    getDoubleQuotedToken();
 
-    bool    isWhitespace(QChar ch);
-    bool    isPunctuation(QChar ch);
+    bool    isWhitespace(char ch);
+    bool    isPunctuation(char ch);
+    static  char asciiUpper(char ch);
 
 private:
-    QString filename;
-    QString nexusData;
-
-    QTextStream &in;
+    void    initialize();
+    void    setData(const uchar *bytes, qint64 size);
+    void    selectClassTable();
+
+    // Bits of a classification table entry
+    enum    CharacterClass {
+        whitespaceClass = 0x01,
+        punctuationClass = 0x02
+    };
 
-    bool    searchForCharInList(QList<QChar> searchIn, QChar searchFor);
+    const char *data;               // the bytes being tokenized, either the file mapping or dataBuffer
+    qint64  dataSize;
+    QByteArray dataBuffer;          // holds the file contents when the file could not be mapped
 
-    qint64  filePos;                // current file position
+    qint64  filePos;                // current file position, in bytes
     qint64  fileLine;               // current file line
     qint64  fileCol;                // current column in current line (refers to column immediately following token just read)
+    qint64  charPos;                // position of the last character returned by getNextChar()
 
-    QString token;                  // the character buffer used to store the current token
-    QString comment;                // temporary buffer used to store output comments while they are being built
+    qint64  tokenStart;             // while isTokenView the token is the bytes tokenStart to tokenStart+tokenLength
+    int     tokenLength;
+    bool    isTokenView;
+    QByteArray tokenBuffer;         // the token once it can no longer be a view into the input
+    QString tokenString;            // the token as text, built on demand by getToken()
+    bool    isTokenStringValid;
+    QByteArray comment;             // temporary buffer used to store output comments while they are being built
 
-    QChar   saved;                  // either '\0' or is last character read from input stream
+    char    saved;                  // either '\0' or is last character read from input stream
     bool    atEndOfFile;            // true if end of file has been encountered
     bool    atEndOfLine;            // true if newline encountered while newlineIsToken labile flag set
-    QChar   special;                // ad hoc punctuation character; default value is '\0'
+    char    special;                // ad hoc punctuation character; default value is '\0', baked into the class tables
     int     labileFlags;            // storage for flags in the NexusTokenFlags enum
-    QList<QChar>    punctuation;    // stores the 20 NEXUS punctuation characters
-    QList<QChar>    whitespace;     // stores the 3 whitespace characters: blank space, tab and newline
+    QByteArray punctuation;         // stores the 20 NEXUS punctuation characters
+    QByteArray whitespace;          // stores the 3 whitespace characters: blank space, tab and newline
+
+    // Every byte is classified with a single table lookup. There is one 256 entry table for each combination of the
+    // labile flags that change what counts as whitespace or punctuation, each built the first time it is needed.
+    quint8  classTables[32][256];
+    quint32 classTablesBuilt;       // bit n set once classTables[n] has been built
+    quint8  *classTable;            // the table for the current labile flags
 };
 
 #endif // NEXUSPARSERTOKEN_H
@@ -17,9 +17,19 @@
 
 #include "settings.h"
 
+QHash<QString, QVariant> Settings::cache;
+QSet<QString> Settings::changedKeys;
+bool Settings::isCacheLoaded = false;
+QMutex Settings::cacheMutex;
+
 //-- Contructor:
 Settings::Settings()
 {
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushDelay);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
     defaultSettingsList.insert("appVersion",QString::number(APP_VERSION, 'f', 1));
 
     defaultSettingsList.insert("defaultNumberTaxa","10");
@@ -71,13 +81,28 @@ Settings::Settings()
     defaultSettingsList.insert("defaultNucleotideEquateStates", defaultNucleotideEquateStates);
     defaultSettingsList.insert("defaultProteinEquateStates", defaultProteinEquateStates);
 
+    // Memory cap of each matrix's undo history, in MB
+    defaultSettingsList.insert("undoMemoryLimit","32");
+
+    // Least severe message shown in the log: 0 debug, 1 info, 2 warning, 3 error
+    defaultSettingsList.insert("logLevel","1");
+
+    // How saved files store cells: 0 one row per cell, 1 one compressed row per taxon
+    defaultSettingsList.insert("fileStorage","1");
+
     defaultSettingsList.insert("enabledColor",QColor(0,153,0).rgba());
     defaultSettingsList.insert("disabledColor",QColor(153,0,0).rgba());
 }
 
+Settings::~Settings()
+{
+    flush();
+}
+
 void Settings::initialize()
 {
     mw->logAppend("Application Settings","retrieving application settings.");
+    loadCache();
     // Create default settings
     if (isFileEmpty() == true)
     {
@@ -86,10 +111,25 @@ void Settings::initialize()
     mw->logAppend("Application Settings","finished loading all application settings.");
 }
 
-bool Settings::isFileEmpty()
+// Read every key in settings.ini, only the first call does any work
+void Settings::loadCache()
 {
+    QMutexLocker locker(&cacheMutex);
+    if (isCacheLoaded) {
+        return;
+    }
+
     QSettings settingsFile("settings.ini", QSettings::IniFormat);
-    if(settingsFile.contains("appVersion") == true)
+    foreach (QString key, settingsFile.allKeys()) {
+        cache.insert(key, settingsFile.value(key));
+    }
+    isCacheLoaded = true;
+}
+
+bool Settings::isFileEmpty()
+{
+    QMutexLocker locker(&cacheMutex);
+    if(cache.contains("appVersion") == true)
     {       
         mw->logAppend("Application Settings","settings.ini found.");
         return false;
@@ -102,21 +142,52 @@ bool Settings::isFileEmpty()
 void Settings::setDefaultSettings()
 {
     mw->logAppend("Application Settings","creating/restoring default .ini file.");
-    QSettings settingsFile("settings.ini", QSettings::IniFormat);
-
-    QHash<QString, QVariant>::const_iterator i;
-    for (i = defaultSettingsList.constBegin(); i != defaultSettingsList.constEnd(); ++i)
-        settingsFile.setValue(i.key(), i.value());
+    {
+        QMutexLocker locker(&cacheMutex);
+        QHash<QString, QVariant>::const_iterator i;
+        for (i = defaultSettingsList.constBegin(); i != defaultSettingsList.constEnd(); ++i) {
+            cache.insert(i.key(), i.value());
+            changedKeys.insert(i.key());
+        }
+    }
+    flush();
 }
 
 void Settings::setSetting(QString key, QVariant value)
 {
-    QSettings settingsFile("settings.ini", QSettings::IniFormat);
-    settingsFile.setValue(key, value);
+    QMutexLocker locker(&cacheMutex);
+    cache.insert(key, value);
+    changedKeys.insert(key);
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
 }
 
+// Keys missing from an older settings.ini fall back to their default
 QVariant Settings::getSetting(QString key)
 {
+    QMutexLocker locker(&cacheMutex);
+    QHash<QString, QVariant>::const_iterator i = cache.constFind(key);
+    if (i != cache.constEnd()) {
+        return i.value();
+    }
+    return defaultSettingsList.value(key);
+}
+
+// Write all changed settings to settings.ini in one go
+void Settings::flush()
+{
+    flushTimer->stop();
+
+    QMutexLocker locker(&cacheMutex);
+    if (changedKeys.isEmpty()) {
+        return;
+    }
+
     QSettings settingsFile("settings.ini", QSettings::IniFormat);
-    return settingsFile.value(key);
+    foreach (QString key, changedKeys) {
+        settingsFile.setValue(key, cache.value(key));
+    }
+    settingsFile.sync();
+    changedKeys.clear();
 }
@@ -21,13 +21,18 @@
 #include "mainwindow.h"
 
 #include <QDebug>
+#include <QMutex>
+#include <QTimer>
 
 class MainWindow;
 
-class Settings
+class Settings : public QObject
 {
+    Q_OBJECT
+
 public:   
     Settings();
+    ~Settings();
     void initialize();
 
     MainWindow *mw;
@@ -36,10 +41,23 @@ public:
     void setSetting(QString key, QVariant value);
     QVariant getSetting(QString key);
 
+public slots:
+    void flush();
+
 private:
     bool isFileEmpty();
 
     QHash<QString, QVariant> defaultSettingsList;
+
+    // settings.ini is read once into a cache shared by the whole process, so getSetting() never touches the disk.
+    // Changes are written back together, shortly after the first one or on flush() at shutdown.
+    enum { FlushDelay = 1000 };
+    static QHash<QString, QVariant> cache;
+    static QSet<QString> changedKeys;
+    static bool isCacheLoaded;
+    static QMutex cacheMutex;
+    QTimer *flushTimer;
+    void loadCache();
 };
 
 #endif // SETTINGS_H
@@ -166,13 +166,9 @@ void TaxaDialog::saveData(int row)
             name = "Undefined";
         }
 
-        matrix->taxonList[row].setLabel(name);
+        matrix->taxonEdit(row, name, notesTextEdit->toHtml(), isEnabledCheckBox->isChecked());
         taxonListTableWidget->item(row, 0)->setText(name);
         mw->updateTaxaDock();
-
-        matrix->taxonList[row].setNotes(notesTextEdit->toHtml());
-        matrix->taxonList[row].setIsEnabled(isEnabledCheckBox->isChecked());
-
         mw->updateDataDock();
     } else {
         doNotSave = false;
@@ -272,7 +268,6 @@ void TaxaDialog::actionUpArrow()
         moveRow(true);
         matrix->moveRow(currentSelectedRow, true);
         mw->moveTaxaDockTableRow(currentSelectedRow, true);
-        matrix->taxonList.move(currentSelectedRow,currentSelectedRow-1);
         updateButtons(currentSelectedRow-1);
     }
 }
@@ -284,7 +279,6 @@ void TaxaDialog::actionDownArrow()
         moveRow(false);
         matrix->moveRow(currentSelectedRow, false);
         mw->moveTaxaDockTableRow(currentSelectedRow, false);
-        matrix->taxonList.move(currentSelectedRow,currentSelectedRow+1);
         updateButtons(currentSelectedRow+1);
     }
 }
@@ -393,12 +387,10 @@ void TaxaDialog::updateTableTaxonName(QString text)
 {
     taxonListTableWidget->item(selectedRow, 0)->setText(text);
     mw->updateTaxaDockTableText(selectedRow, text);
-    matrix->updateLeftTableText(selectedRow, text);
 }
 
 void TaxaDialog::isEnabledChanged(bool isEnabled)
 {
-    matrix->taxonList[selectedRow].setIsEnabled(isEnabled);
     updateTaxaTableColor(selectedRow, isEnabled);
     mw->updateTaxaDockTableColor(selectedRow, isEnabled);
 }